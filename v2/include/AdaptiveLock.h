@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <array>
+
+namespace myMemoryPool {
+
+// 锁的争用统计，多个锁可以共用一个（例如CentralCache所有size class的锁）
+// 等待/持有时间的直方图只在开启AdaptiveLock::setProfiling之后才记录
+struct LockStats {
+    // 第i个桶统计[2^i, 2^(i+1))纳秒的次数
+    static const size_t BUCKETS = 40;
+
+    std::atomic<size_t> contended{0}; // 快速路径CAS失败、进入自旋的次数
+    std::atomic<size_t> parked{0}; // 自旋之后仍然没有拿到锁、在futex上睡眠的次数
+    std::array<std::atomic<size_t>, BUCKETS> waitNs{}; // 等待时间直方图
+    std::array<std::atomic<size_t>, BUCKETS> holdNs{}; // 持有时间直方图
+
+    void reset();
+    // 按直方图估计第p（0~1）分位数，返回所在桶的上界（纳秒）
+    static size_t percentile(const std::array<std::atomic<size_t>, BUCKETS>& histogram, double p);
+    static size_t total(const std::array<std::atomic<size_t>, BUCKETS>& histogram);
+};
+
+// 内存池内部使用的锁：先CAS尝试获取，失败后有界地指数退避自旋（pause），仍然失败再用futex睡眠
+// 线程数多于CPU核数时不会像yield自旋那样空转，持有锁的线程被抢占时等待者直接睡眠
+// 满足BasicLockable，可以配合std::lock_guard使用
+class AdaptiveLock {
+public:
+    constexpr AdaptiveLock() = default;
+    AdaptiveLock(const AdaptiveLock&) = delete;
+    AdaptiveLock& operator=(const AdaptiveLock&) = delete;
+
+    void lock() {
+        if(profiling_.load(std::memory_order_relaxed)) {
+            lockProfiled();
+            return;
+        }
+        uint32_t expected = UNLOCKED;
+        if(!state_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            lockSlow();
+        }
+    }
+
+    void unlock() {
+        if(acquiredAt_) {
+            recordHold();
+        }
+        // 有线程在futex上睡眠时唤醒一个
+        if(state_.exchange(UNLOCKED, std::memory_order_release) == PARKED) {
+            wake();
+        }
+    }
+
+    // 争用统计写到stats中，为nullptr时不统计
+    void setStats(LockStats* stats) { stats_ = stats; }
+
+    // 开启/关闭所有锁的等待/持有时间统计（每次加锁多两次读时钟）
+    static void setProfiling(bool enable) { profiling_.store(enable, std::memory_order_relaxed); }
+
+private:
+    void lockSlow();
+    void lockProfiled();
+    void recordHold();
+    void wake();
+
+private:
+    static const uint32_t UNLOCKED = 0;
+    static const uint32_t LOCKED = 1; // 已加锁，没有睡眠的等待者
+    static const uint32_t PARKED = 2; // 已加锁，可能有睡眠的等待者
+
+    std::atomic<uint32_t> state_{UNLOCKED};
+    uint64_t acquiredAt_ = 0; // 开启统计时加锁的时间（纳秒），只由持有锁的线程读写
+    LockStats* stats_ = nullptr;
+
+    static std::atomic<bool> profiling_;
+};
+
+} // namespace myMemoryPool
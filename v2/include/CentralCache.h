@@ -1,6 +1,9 @@
 #pragma once
 #include "Common.h"
+#include "PageCache.h"
+#include "AdaptiveLock.h"
 #include <mutex>
+#include <cstdint>
 
 namespace myMemoryPool {
 
@@ -11,30 +14,128 @@ public:
         return instance;
     }
 
-    //  CentralCache用于分配对应索引位置（映射到对应内存块大小的链表）的内存块给ThreadCache
-    void* fetchMemory(size_t index);
+    // CentralCache批量分配对应索引位置（映射到对应内存块大小的链表）的内存块给ThreadCache
+    // 最多取batchNum个内存块写入batch数组，返回值为实际取到的内存块数量
+    // 从Span中取内存块时把Span的owner设为申请线程的远程释放队列owner（可以为nullptr），其他线程释放时按owner归还
+    // zeroedMask不为nullptr时，batch[i]是从清零的Span（isZeroed）中新切分出来的、内容一定为0时第i位置1
+    size_t fetchRange(void** batch, size_t batchNum, size_t index, RemoteFreeQueue* owner = nullptr, uint32_t* zeroedMask = nullptr);
+    static_assert(MAX_BATCH_NUM <= 32, "zeroedMask中每个内存块占一位");
 
-    // CentralCache用来接受上层的ThreadCache释放的索引为index的内存块链表，并通过头插法插入到CentralCache对应index的空闲链表
+    // CentralCache用来接受上层的ThreadCache释放的count个索引为index的内存块，优先放入转移缓存，
+    // 放不下的部分通过头插法插入到所属Span的空闲链表，Span中的内存块全部归还之后，Span归还给PageCache
+    void returnMemory(void** batch, size_t count, size_t index);
+    // 归还以start为头、nullptr结尾的链表，按批次转换成指针数组之后调用上面的版本，上层的线程本地链表使用
     void returnMemory(void* start, size_t index);
 
+    // 把转移缓存中的内存块全部归还给所属的Span，返回归还的内存块数量
+    size_t flush();
+
+    // 统计信息：Span链表的加锁次数、分配给ThreadCache的内存块总数以及完全由转移缓存满足的申请次数
+    size_t getLockAcquireCount() const { return lockAcquireCount_.load(std::memory_order_relaxed); }
+    size_t getFetchedBlockCount() const { return fetchedBlockCount_.load(std::memory_order_relaxed); }
+    size_t getTransferHitCount() const { return transferHitCount_.load(std::memory_order_relaxed); }
+    // 所有Span链表的锁共用的争用统计（转移缓存是无锁的）
+    LockStats& getLockStats() { return lockStats_; }
+
+    // 每个size class的转移缓存最多缓存的批次数，每个批次最多numMoveSize个内存块
+    static constexpr size_t MAX_CACHED_BATCHES = 8;
+    // 分片数量上限，实际分片数为min(CPU数, MAX_SHARDS)
+    static constexpr size_t MAX_SHARDS = 8;
+
+    // 分片数量以及从其他分片窃取内存块的次数
+    size_t shardCount() const { return numShards_; }
+    size_t getStealCount() const { return stealCount_.load(std::memory_order_relaxed); }
+
 private:
-    // 初始化为链表全空，以及lock全为false
+    // 初始化为链表全空，所有lock共用一个争用统计
     CentralCache() {
-        for(auto& ptr : centralFreeList_) {
-            ptr.store(nullptr, std::memory_order_relaxed);
+        for(auto& shard : shards_) {
+            for(auto& list : shard.spanLists) {
+                PageCache::listInit(&list);
+            }
+            for(auto& lock : shard.locks) {
+                lock.setStats(&lockStats_);
+            }
         }
-
-        for(auto& lock : locks_) {
-            lock.clear();
+        // 所有批次一开始都在空栈中
+        for(auto& cache : transfer_) {
+            for(uint32_t id = 0; id < MAX_CACHED_BATCHES; id ++) {
+                pushBatch(cache, cache.empty, id);
+            }
         }
+        numShards_ = initShardCount();
     }
 
-    // CentralCache内存块不够上层ThreadCache使用时，向下层的PageCache申请新的内存
-    void* fetchFromPageCache(size_t size);
+    // 转移缓存：每个size class固定数量的指针数组批次，上层申请/归还的内存块只复制指针，不读写内存块本身，
+    // 生产者线程释放、消费者线程申请时不会访问其他CPU cache中的冷内存块
+    // 批次通过无锁栈存取，转移缓存命中时不加任何锁；为空或者已满时只做一次原子读，不影响Span链表的分片
+    // 一个批次只有一个内存块的size class（大内存块）不使用，直接归还给Span，让Span尽快回到PageCache
+    static bool transferable(size_t index);
+    // 把最多count个内存块放入/取出转移缓存，返回实际放入/取出的数量
+    size_t insertTransfer(size_t index, void** batch, size_t count);
+    size_t removeTransfer(size_t index, void** batch, size_t count);
+    // 加锁把数组中的内存块逐个归还给所属的Span（所在分片的Span链表）
+    void returnToSpans(void** batch, size_t count, size_t index);
+
+    // 分片数量：min(CPU数, MAX_SHARDS)
+    static size_t initShardCount();
+    // 当前线程所在CPU对应的分片
+    size_t currentShard() const;
+    // 从shard分片的Span链表中取内存块写入batch[count]开始的位置，直到count达到batchNum或者链表为空，调用者持有锁
+    void takeFromSpans(size_t shard, size_t index, void** batch, size_t& count, size_t batchNum, RemoteFreeQueue* owner, uint32_t* zeroedMask);
+    // 向PageCache申请新的Span放入shard分片并继续取内存块，直到count达到batchNum，调用者持有锁
+    void fillFromPageCache(size_t shard, size_t index, void** batch, size_t& count, size_t batchNum, RemoteFreeQueue* owner, uint32_t* zeroedMask);
+
+    // CentralCache内存块不够上层ThreadCache使用时，向下层的PageCache申请新的Span，用于切分index对应大小的内存块
+    // 不预先切分：新Span的空闲链表为空，内存块在取用时才从carvePtr开始切分，没有用到的页不会被写入
+    PageCache::Span* fetchFromPageCache(size_t index);
+    // Span中是否还有可以分配的内存块（空闲链表或者还没有切分的部分）
+    static bool hasFreeBlocks(const PageCache::Span* span) {
+        return span->freeList || span->carvePtr != span->carveEnd;
+    }
+
+    // size大小的内存块每次从PageCache申请的Span页数
+    static size_t spanPages(size_t size);
+
+    // 获取shard分片中index对应链表的锁，同时累计加锁次数
+    void lock(size_t shard, size_t index);
+    void unlock(size_t shard, size_t index);
 
 private:
     
-    std::array<std::atomic<void*>, FREE_LIST_SIZE> centralFreeList_; // 不同大小内存块对应的链表
-    std::array<std::atomic_flag, FREE_LIST_SIZE> locks_; // 不同大小内存块链表对应的lock
+    // 每个size class按CPU分成多个分片，不同CPU上的线程访问同一个size class时使用不同的锁
+    struct alignas(64) Shard {
+        // 不同大小内存块对应的Span链表（哨兵节点），只包含还有空闲内存块的Span，
+        // 空闲内存块挂在各自Span的freeList中，或者在Span还没有切分的部分中
+        std::array<PageCache::Span, FREE_LIST_SIZE> spanLists;
+        std::array<AdaptiveLock, FREE_LIST_SIZE> locks; // 不同大小内存块链表对应的lock
+    };
+    std::array<Shard, MAX_SHARDS> shards_;
+    size_t numShards_ = 1;
+    LockStats lockStats_;
+
+    // 转移缓存中的一个批次，从栈中弹出之后由弹出的线程独占，修改完再压回栈中
+    struct TransferBatch {
+        std::atomic<uint32_t> next{0}; // 所在栈中下一个批次的编号加一，0表示栈底
+        uint32_t count = 0; // blocks中有效指针的数量
+        void* blocks[MAX_BATCH_NUM];
+    };
+    // 每个size class的转移缓存：MAX_CACHED_BATCHES个批次，有内存块的在满栈中，空的在空栈中
+    // 栈顶为64位：低32位为栈顶批次的编号加一（0表示栈为空），高32位为版本号，每次修改加一，避免CAS的ABA问题
+    struct alignas(64) TransferCache {
+        std::atomic<uint64_t> full{0};
+        std::atomic<uint64_t> empty{0};
+        std::array<TransferBatch, MAX_CACHED_BATCHES> batches;
+    };
+    std::array<TransferCache, FREE_LIST_SIZE> transfer_;
+
+    // 把编号为id的批次压入无锁栈top；从无锁栈top弹出一个批次，栈为空时返回false
+    static void pushBatch(TransferCache& cache, std::atomic<uint64_t>& top, uint32_t id);
+    static bool popBatch(TransferCache& cache, std::atomic<uint64_t>& top, uint32_t& id);
+
+    std::atomic<size_t> lockAcquireCount_{0}; // 加锁次数
+    std::atomic<size_t> fetchedBlockCount_{0}; // 分配给ThreadCache的内存块总数
+    std::atomic<size_t> transferHitCount_{0}; // 完全由转移缓存满足的申请次数
+    std::atomic<size_t> stealCount_{0}; // 从其他分片窃取内存块的次数
 };
 } // namespace myMemoryPool
\ No newline at end of file
@@ -2,19 +2,56 @@
 #include <cstddef>
 #include <atomic>
 #include <array>
+#include <algorithm>
 
 namespace myMemoryPool {
 
 // 对齐值为8，即内存地址为8的整数倍
 constexpr size_t ALIGNMENT = 8;
 constexpr size_t MAX_BYTES = 256 * 1024;
-constexpr size_t FREE_LIST_SIZE = MAX_BYTES / ALIGNMENT;
+
+// size class划分（类似tcmalloc）：
+// 小于等于SMALL_BYTES的部分：8，然后按16字节间隔划分
+// 大于SMALL_BYTES的部分：每翻一倍划分CLASSES_PER_DOUBLING个size class，即相邻size class间隔约12.5%
+constexpr size_t SMALL_ALIGNMENT = 16;
+constexpr size_t SMALL_BYTES = 128;
+constexpr size_t SMALL_SHIFT = 7; // log2(SMALL_BYTES)
+constexpr size_t MAX_SHIFT = 18; // log2(MAX_BYTES)
+constexpr size_t CLASSES_PER_DOUBLING = 8;
+constexpr size_t SMALL_CLASS_NUM = 1 + SMALL_BYTES / SMALL_ALIGNMENT;
+constexpr size_t FREE_LIST_SIZE = SMALL_CLASS_NUM + (MAX_SHIFT - SMALL_SHIFT) * CLASSES_PER_DOUBLING;
+// 大于MAX_BYTES的大对象所在Span使用的size class，不对应任何链表
+constexpr size_t LARGE_SIZE_CLASS = FREE_LIST_SIZE;
+// PageCache空闲链表中的Span使用的size class，和任何已分配的Span都不相同
+constexpr size_t FREE_SPAN_CLASS = FREE_LIST_SIZE + 1;
+
+// ThreadCache与CentralCache之间单次批量搬运的内存块数量上限
+constexpr size_t MAX_BATCH_NUM = 32;
+// 单次批量搬运的字节数上限，大对象按字节数进一步限制搬运数量
+constexpr size_t MAX_BATCH_BYTES = 64 * 1024;
+
+// 生成每个size class对应的内存块大小
+constexpr std::array<size_t, FREE_LIST_SIZE> makeClassSizes() {
+    std::array<size_t, FREE_LIST_SIZE> sizes{};
+    sizes[0] = ALIGNMENT;
+    for(size_t i = 1; i < SMALL_CLASS_NUM; i ++) {
+        sizes[i] = i * SMALL_ALIGNMENT;
+    }
+    for(size_t i = SMALL_CLASS_NUM; i < FREE_LIST_SIZE; i ++) {
+        size_t lg = SMALL_SHIFT + (i - SMALL_CLASS_NUM) / CLASSES_PER_DOUBLING;
+        size_t offset = (i - SMALL_CLASS_NUM) % CLASSES_PER_DOUBLING;
+        sizes[i] = (size_t(1) << lg) + (offset + 1) * (size_t(1) << (lg - 3));
+    }
+    return sizes;
+}
+
+inline constexpr std::array<size_t, FREE_LIST_SIZE> CLASS_SIZES = makeClassSizes();
 
 class SizeClass {
 public:
-    // 不是8的整数倍的size被填充至整数倍
+    // 把size向上取整到所在size class的内存块大小
     static size_t roundUp(size_t bytes) {
-        return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        return classSize(getIndex(bytes));
     }
 
     // 获取bytes字节大小的内存映射到的索引
@@ -23,13 +60,47 @@ public:
     // 索引                 内存块大小
     // 0                        8
     // 1                        16
-    // 2                        24
+    // 2                        32
+    // ...
+    // 8                        128
+    // 9                        144
+    // 10                       160
+    // ...
+    // 16                       256
+    // 17                       288
     // ...
-    // FREE_LIST_SIZE       MAX_BYTES
+    // FREE_LIST_SIZE - 1   MAX_BYTES
     static size_t getIndex(size_t bytes) {
-        bytes = std::max(bytes, ALIGNMENT);
-        // 0-based
-        return (bytes + ALIGNMENT - 1) / ALIGNMENT - 1;
+        if(bytes <= ALIGNMENT) return 0;
+        if(bytes <= SMALL_BYTES) return (bytes + SMALL_ALIGNMENT - 1) / SMALL_ALIGNMENT;
+
+        // lg = floor(log2(bytes - 1))，(bytes - 1) >> (lg - 3) 的低3位即在这一倍区间内的偏移
+        size_t lg = 63 - __builtin_clzll(bytes - 1);
+        return SMALL_CLASS_NUM + (lg - SMALL_SHIFT) * CLASSES_PER_DOUBLING 
+            + (((bytes - 1) >> (lg - 3)) & (CLASSES_PER_DOUBLING - 1));
+    }
+
+    // 内存块大小是alignment的整数倍、并且能放下bytes字节的最小size class的索引，没有时返回FREE_LIST_SIZE
+    // Span按页对齐，所以alignment不超过页大小时这样的size class中每个内存块都按alignment对齐
+    // alignment为2的幂
+    static size_t getAlignedIndex(size_t bytes, size_t alignment) {
+        if(bytes > MAX_BYTES) return FREE_LIST_SIZE;
+        for(size_t index = getIndex(std::max(bytes, alignment)); index < FREE_LIST_SIZE; index ++) {
+            if(CLASS_SIZES[index] % alignment == 0) return index;
+        }
+        return FREE_LIST_SIZE;
+    }
+
+    // 索引对应的内存块大小
+    static size_t classSize(size_t index) {
+        return CLASS_SIZES[index];
+    }
+
+    // size大小的内存块单次批量搬运的数量上限：小对象多搬，大对象少搬，至少为1
+    static size_t numMoveSize(size_t size) {
+        if(size == 0) return 0;
+        size_t num = MAX_BATCH_BYTES / size;
+        return std::max<size_t>(1, std::min(num, MAX_BATCH_NUM));
     }
 };
 
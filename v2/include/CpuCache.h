@@ -0,0 +1,75 @@
+#pragma once
+#include "Common.h"
+#include "AdaptiveLock.h"
+#include <cstdint>
+
+namespace myMemoryPool {
+
+// 可选的per-CPU前端（类似tcmalloc的per-CPU模式）：按线程当前所在的CPU选择缓存，而不是每个线程一份
+// 线程数远多于CPU核数时，缓存的总内存只和CPU数有关，不会滞留在空闲线程的ThreadCache中
+// CPU号优先从glibc注册的rseq区域读取（内核在线程被调度时更新，读取只需一次内存访问），不支持rseq时使用sched_getcpu
+// 每个CPU的缓存用一个AdaptiveLock保护：读取CPU号之后线程可能被迁移，此时只会和同一CPU上的其他线程竞争，正确性不受影响
+class CpuCache {
+public:
+    static CpuCache& getInstance() {
+        static CpuCache instance;
+        return instance;
+    }
+
+    // 是否开启了per-CPU模式，开启后ThreadCache把小对象的分配/释放转交给CpuCache
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 开启/关闭per-CPU模式，系统不支持获取当前CPU号时开启失败返回false
+    // 关闭时把所有CPU缓存的内存块归还给CentralCache
+    bool setEnabled(bool enable);
+
+    // 分配/释放index对应size class的内存块
+    void* allocate(size_t index);
+    void release(void* ptr, size_t index);
+
+    // 把所有CPU缓存的内存块归还给CentralCache，返回归还的字节数
+    size_t flush();
+    // 所有CPU缓存的内存块总字节数，不加锁读取，结果是近似值
+    size_t cachedBytes() const;
+    // 缓存的CPU数量以及当前线程所在的CPU，不支持时返回-1
+    size_t cpuCount() const { return numCpus_; }
+    static int currentCpu();
+
+private:
+    CpuCache() = default;
+
+    struct FreeList {
+        void* head = nullptr; //链表头节点
+        // 链表长度：只在持有slot.lock时修改，cachedBytes()不加锁读取其他CPU的长度，所以是原子变量
+        // 修改用relaxed的读+写（setLength）而不是原子加减，和普通变量的开销一样
+        std::atomic<uint32_t> size{0};
+        uint32_t maxBatch = 0; //向CentralCache批量申请的数量，慢启动
+
+        uint32_t length() const { return size.load(std::memory_order_relaxed); }
+        void setLength(size_t length) { size.store(static_cast<uint32_t>(length), std::memory_order_relaxed); }
+    };
+
+    // 每个CPU的缓存按cache line对齐，不同CPU之间没有伪共享
+    struct alignas(64) Slot {
+        AdaptiveLock lock;
+        std::array<FreeList, FREE_LIST_SIZE> freeList;
+    };
+
+    // 当前CPU对应的缓存，并加锁
+    Slot& lockCurrent();
+    static void lock(Slot& slot);
+    static void unlock(Slot& slot);
+
+    // 把slot中index对应链表的内存块全部（或者只保留keepNum个）归还给CentralCache
+    static size_t returnToCentralCache(Slot& slot, size_t index, size_t keepNum);
+
+private:
+    static std::atomic<bool> enabled_;
+
+    Slot* slots_ = nullptr; // numCpus_个CPU缓存，第一次开启时直接向系统申请
+    size_t numCpus_ = 0;
+};
+
+} // namespace myMemoryPool
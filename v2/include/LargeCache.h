@@ -0,0 +1,69 @@
+#pragma once
+#include "Common.h"
+#include "PageCache.h"
+#include "AdaptiveLock.h"
+#include <mutex>
+
+namespace myMemoryPool {
+
+// 大于MAX_BYTES的大对象直接由PageCache的Span提供，每个大对象独占一个Span
+// LargeCache按页数分桶缓存最近释放的大对象Span（不合并、不归还操作系统），相同档位的申请可以直接复用，
+// 避免每次都在PageCache中切分/合并以及重新触发缺页
+class LargeCache {
+public:
+    static LargeCache& getInstance() {
+        static LargeCache instance;
+        return instance;
+    }
+
+    // 分配size大小（大于MAX_BYTES）的内存
+    void* allocate(size_t size);
+    // 释放大对象以及按页对齐分配的对象，span为ptr所在的Span
+    void release(PageCache::Span* span);
+    // 把缓存的Span全部归还给PageCache，返回归还的页数
+    size_t flush();
+
+    // 统计信息：缓存的字节数、命中次数以及未命中次数
+    size_t getCachedBytes();
+    size_t getHitCount();
+    size_t getMissCount();
+    // LargeCache锁的争用统计
+    LockStats& getLockStats() { return lockStats_; }
+
+    // 大对象实际占用的页数：按约12.5%的间隔向上取整，使同一档位的Span可以互相复用
+    static size_t roundUpPages(size_t numPages) {
+        if(numPages <= 8) return numPages;
+        size_t lg = 63 - __builtin_clzll(numPages - 1);
+        size_t step = size_t(1) << (lg - 3);
+        return (numPages + step - 1) & ~(step - 1);
+    }
+
+private:
+    LargeCache() {
+        mutex_.setStats(&lockStats_);
+    }
+
+    // 页数对应的桶下标，页数超过MAX_CACHED_PAGES的Span不缓存
+    static size_t bucketIndex(size_t numPages) {
+        size_t lg = 63 - __builtin_clzll(numPages - 1);
+        return (lg - MIN_SHIFT) * 8 + (((numPages - 1) >> (lg - 3)) & 7);
+    }
+
+private:
+    // 大对象至少MAX_BYTES / PAGE_SIZE + 1页
+    static const size_t MIN_SHIFT = 6; // log2(MAX_BYTES / PAGE_SIZE)
+    // 最多缓存64MB（16384页）以内的Span，所有桶缓存的总字节数不超过MAX_CACHED_BYTES
+    static const size_t MAX_CACHED_PAGES = 16384;
+    static const size_t MAX_SHIFT = 14; // log2(MAX_CACHED_PAGES)
+    static const size_t BUCKET_NUM = (MAX_SHIFT - MIN_SHIFT) * 8;
+    static const size_t MAX_CACHED_BYTES = 64 * 1024 * 1024;
+
+    std::array<PageCache::Span*, BUCKET_NUM> buckets_{}; // 每个桶是一个用next连接的Span栈
+    size_t cachedBytes_ = 0;
+    size_t hitCount_ = 0;
+    size_t missCount_ = 0;
+    AdaptiveLock mutex_; // 大对象的申请和释放都经过这把锁
+    LockStats lockStats_;
+};
+
+} // namespace myMemoryPool
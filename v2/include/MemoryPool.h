@@ -1,5 +1,9 @@
 #pragma once
 #include "ThreadCache.h"
+#include "PageCache.h"
+#include "LargeCache.h"
+#include "CpuCache.h"
+#include "CentralCache.h"
 
 namespace myMemoryPool {
 
@@ -9,9 +13,69 @@ public:
         return ThreadCache::getInstance()->allocate(size);
     }
 
+    // 分配清零的内存，相当于calloc
+    static void* allocateZeroed(size_t size) {
+        return ThreadCache::getInstance()->allocateZeroed(size);
+    }
+
+    // 分配起始地址按alignment（2的幂）对齐的内存，例如64字节对齐避免伪共享、4096字节对齐的整页
+    static void* allocateAligned(size_t size, size_t alignment) {
+        return ThreadCache::getInstance()->allocateAligned(size, alignment);
+    }
+
+    // 释放allocateAligned分配的内存，也可以用不带size的release释放
+    static void releaseAligned(void* ptr, size_t size, size_t alignment) {
+        ThreadCache::getInstance()->releaseAligned(ptr, size, alignment);
+    }
+
     static void release(void* ptr, size_t size) {
         ThreadCache::getInstance()->release(ptr, size);
     }
+
+    // 无需传入size的释放，可以替代free()；传入size的版本更快
+    static void release(void* ptr) {
+        ThreadCache::getInstance()->release(ptr);
+    }
+
+    // 调整allocate分配的内存的大小（realloc），oldSize与分配时相同，返回新的地址；
+    // 新的大小仍在原来的size class中或者大对象可以原地扩展时返回ptr本身
+    static void* reallocate(void* ptr, size_t oldSize, size_t newSize) {
+        return ThreadCache::getInstance()->reallocate(ptr, oldSize, newSize);
+    }
+
+    // ptr所在内存块实际可用的字节数，相当于malloc_usable_size
+    static size_t usableSize(const void* ptr) {
+        return ThreadCache::usableSize(ptr);
+    }
+
+    // ptr是否是内存池分配的地址
+    static bool owns(const void* ptr) {
+        return PageCache::getInstance().owns(ptr);
+    }
+
+    // 开启/关闭per-CPU缓存模式（默认关闭，使用每个线程的ThreadCache），系统不支持时开启失败返回false
+    static bool setPerCpuMode(bool enable) {
+        return CpuCache::getInstance().setEnabled(enable);
+    }
+
+    // 开启/关闭远程释放模式（默认关闭）：跨线程释放的小对象归还给申请它的线程
+    static void setRemoteFree(bool enable) {
+        ThreadCache::setRemoteFree(enable);
+    }
+
+    // 设置所有线程的ThreadCache共享的缓存字节数预算，默认ThreadCache::DEFAULT_BUDGET
+    static void setThreadCacheBudget(size_t bytes) {
+        ThreadCache::setBudget(bytes);
+    }
+
+    // 把per-CPU缓存、CentralCache转移缓存中的内存块和缓存的大对象Span交还下层，
+    // 再把PageCache中所有空闲页归还给操作系统，返回归还的字节数
+    static size_t releaseFreeMemory() {
+        CpuCache::getInstance().flush();
+        CentralCache::getInstance().flush();
+        LargeCache::getInstance().flush();
+        return PageCache::getInstance().releaseFreeMemory() * PageCache::PAGE_SIZE;
+    }
 };
 
 } // namespace myMemoryPool
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <sys/mman.h>
+
+namespace myMemoryPool {
+
+// 内存池内部元数据（Span等）的定长对象分配器
+// 直接从mmap申请的大块内存中切分，回收的对象挂在空闲链表中复用，从不调用new/malloc，也从不归还给操作系统
+// 不加锁，由调用者保证互斥
+template <typename T>
+class MetadataAllocator {
+public:
+    constexpr MetadataAllocator() = default;
+
+    // 分配一个值初始化的T对象，系统内存不足时返回nullptr
+    T* allocate() {
+        void* result = nullptr;
+
+        if(freeList_) {
+            // 优先复用回收的对象
+            result = freeList_;
+            freeList_ = *reinterpret_cast<void**>(freeList_);
+        }else {
+            // 当前大块内存剩余空间不够，重新向系统申请一块
+            if(freeBytes_ < OBJECT_SIZE) {
+                void* chunk = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(chunk == MAP_FAILED) return nullptr;
+
+                freeArea_ = static_cast<char*>(chunk);
+                freeBytes_ = CHUNK_SIZE;
+                chunkBytes_ += CHUNK_SIZE;
+            }
+            result = freeArea_;
+            freeArea_ += OBJECT_SIZE;
+            freeBytes_ -= OBJECT_SIZE;
+        }
+
+        inUse_ ++;
+        return new (result) T();
+    }
+
+    void deallocate(T* obj) {
+        obj->~T();
+        *reinterpret_cast<void**>(obj) = freeList_;
+        freeList_ = obj;
+        inUse_ --;
+    }
+
+    // 正在使用的对象数量以及向系统申请的总字节数
+    size_t inUse() const { return inUse_; }
+    size_t chunkBytes() const { return chunkBytes_; }
+
+private:
+    // 每个对象至少能放下空闲链表的next指针，并按T的对齐要求对齐
+    static constexpr size_t OBJECT_ALIGN = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+    static constexpr size_t OBJECT_SIZE = ((sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*))
+        + OBJECT_ALIGN - 1) & ~(OBJECT_ALIGN - 1);
+    // 每次向系统申请的大块内存大小
+    static constexpr size_t CHUNK_SIZE = 128 * 1024;
+
+    char* freeArea_ = nullptr; // 当前大块内存中还没有切分的部分
+    size_t freeBytes_ = 0; // 当前大块内存中还没有切分的字节数
+    void* freeList_ = nullptr; // 回收对象的空闲链表
+    size_t inUse_ = 0;
+    size_t chunkBytes_ = 0;
+};
+
+} // namespace myMemoryPool
@@ -1,43 +1,221 @@
 #pragma once
 #include "Common.h"
-#include <map>
+#include "PageMap.h"
+#include "MetadataAllocator.h"
+#include "AdaptiveLock.h"
 #include <mutex>
+#include <chrono>
 
 namespace myMemoryPool {
 
+struct RemoteFreeQueue;
+
 class PageCache {
 public:
     // 固定页大小为4KB
-    static const size_t PAGE_SIZE = 4 * 1024;
+    static const size_t PAGE_SHIFT = 12;
+    static const size_t PAGE_SIZE = size_t(1) << PAGE_SHIFT;
+    // 虚拟地址的有效位数
+    static const size_t ADDRESS_BITS = 48;
+    // 页数小于MAX_PAGES的空闲Span按页数放在freeLists_中，大于等于MAX_PAGES的放在largeList_中
+    static const size_t MAX_PAGES = 128;
+    // 大页模式下向系统申请内存的粒度：2MB对齐的整块区域
+    static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static const size_t HUGE_PAGE_PAGES = HUGE_PAGE_SIZE / PAGE_SIZE;
+    // 初始化时预留的虚拟地址空间大小（只占地址，不占物理内存），页从预留范围中按顺序切分
+    static const size_t RESERVE_BYTES = size_t(64) << 30;
+    // 预留范围每次设置为可读写的粒度，减少系统调用次数
+    static const size_t COMMIT_BYTES = 64 * 1024 * 1024;
+    // movePages最多成功移动的次数：每次移动都会把预留范围的映射多拆出几段，总数受vm.max_map_count（默认65530）限制
+    static const size_t MAX_REMAPS = 8192;
+
+    // Span结构体定义，用于构建双向链表
+    struct Span {
+        void* pageAddr;  //Span内存开始地址
+        size_t numPages; //Span包含的Page数量
+        Span* next;      //next指针指向下一个Span
+        Span* prev;      //prev指针指向上一个Span，从空闲链表中摘除时为O(1)
+        size_t sizeClass; //Span被切分成的内存块对应的size class，空闲时为FREE_SPAN_CLASS
+        bool isFree;     //是否在PageCache的空闲链表中
+        void* freeList;  //交给CentralCache后，Span中归还回来的空闲内存块组成的链表
+        char* carvePtr;  //交给CentralCache后，Span中还没有切分出去的部分[carvePtr, carveEnd)，按需从carvePtr开始切分
+        char* carveEnd;
+        size_t useCount; //交给CentralCache后，Span中分配给ThreadCache的内存块数量
+        size_t shard;    //交给CentralCache后，所在的CentralCache分片
+        std::atomic<RemoteFreeQueue*> owner; //交给CentralCache后，最近从这个Span的空闲链表取走内存块的线程的远程释放队列
+        bool isReleased; //空闲时其中的页是否已经通过madvise归还给操作系统
+        bool isZeroed;   //其中的页是否全部为0（刚从系统申请或者已经归还给操作系统），分配出去之后保持分配时的状态
+        std::chrono::steady_clock::time_point freeTime; //进入空闲链表的时间
+    };
+
+    // 带哨兵节点的环形双向链表操作，PageCache的空闲链表以及CentralCache的Span链表共用
+    static void listInit(Span* list) {
+        list->next = list;
+        list->prev = list;
+    }
+    static bool listEmpty(const Span* list) {
+        return list->next == list;
+    }
+    // 头插法
+    static void listPush(Span* list, Span* span) {
+        span->next = list->next;
+        span->prev = list;
+        list->next->prev = span;
+        list->next = span;
+    }
+    static void listRemove(Span* span) {
+        span->prev->next = span->next;
+        span->next->prev = span->prev;
+        span->next = nullptr;
+        span->prev = nullptr;
+    }
 
     static PageCache& getInstance() {
         static PageCache instance;
         return instance;
     }
 
-    // PageCache分配Span(若干个Page)
-    void* allocateSpan(size_t numPages);
+    // PageCache分配Span(若干个Page)，Span用于切分sizeClass对应大小的内存块
+    // alignPages大于1时Span的起始地址按alignPages页对齐（alignPages为2的幂）
+    void* allocateSpan(size_t numPages, size_t sizeClass, size_t alignPages = 1);
     // PageCache回收Span
     void releaseSpan(void* ptr, size_t numPages);
+    // 把已分配的Span原地扩展到newPages页：右边相邻的空闲Span足够大时直接并入，Span位于预留范围的末尾时先继续切分
+    // 成功返回true，span->numPages更新为newPages，失败时Span不变
+    bool growSpan(Span* span, size_t newPages);
+    // 把从ptr开始的已分配Span拆成两个：前numPages页留在原Span中，剩下的页成为一个新的已分配Span（size class等状态相同）
+    // 返回新Span的起始地址，ptr不是已分配Span的起始地址或者numPages不小于Span的页数时返回nullptr
+    void* splitSpan(void* ptr, size_t numPages);
+    // movePages的结果
+    enum class MoveResult {
+        Failed,   // 没有移动，两边的数据都不变
+        Moved,    // 数据已经移动到to，from处重新映射为清零的页
+        Unmapped, // 数据已经移动到to，但是from处重新映射失败，这些页不能再交给任何人使用
+    };
+    // 用mremap把[from, from + numPages页)中的物理页移动到to开始的页（不复制数据），from处重新映射为清零的页
+    // from和to都必须在预留范围内并且由调用者持有，已经移动过MAX_REMAPS次之后不再移动
+    MoveResult movePages(void* from, void* to, size_t numPages);
+    // 丢弃已分配的Span（movePages返回Unmapped时原来的Span）：页表中不再映射这些页，Span元数据回收，页数计入getLostPages
+    void discardSpan(Span* span);
+
+    // 地址所在的页号
+    static size_t pageId(const void* ptr) {
+        return reinterpret_cast<uintptr_t>(ptr) >> PAGE_SHIFT;
+    }
+
+    // 查找ptr所在的Span，ptr不是PageCache分配的内存时返回nullptr
+    // 不加锁：ptr所在Span的页映射在内存分配出去之前就已经写入页表
+    // 空闲Span只映射首尾两页，合并之后中间的页可能还指向已经回收（甚至重新使用）的Span，所以要检查ptr是否在Span的范围内
+    Span* getSpan(const void* ptr) const {
+        Span* span = static_cast<Span*>(pageMap_.get(pageId(ptr)));
+        if(!span) return nullptr;
+        const char* start = static_cast<const char*>(span->pageAddr);
+        const char* p = static_cast<const char*>(ptr);
+        if(p < start || p >= start + span->numPages * PAGE_SIZE) return nullptr;
+        return span;
+    }
+
+    // ptr是否属于内存池管理的地址：预留范围内只需比较地址，范围外（预留用完后直接mmap的内存）再查页表
+    bool owns(const void* ptr) const {
+        if(ptr >= reserveStart_ && ptr < reserveEnd_) return true;
+        Span* span = getSpan(ptr);
+        return span && !span->isFree;
+    }
+
+    // 查找ptr所在Span对应的size class，ptr不是PageCache分配的内存（或者所在的Span是空闲的）时返回false
+    bool getSizeClass(const void* ptr, size_t& sizeClass) const {
+        Span* span = getSpan(ptr);
+        if(!span || span->isFree) return false;
+        sizeClass = span->sizeClass;
+        return true;
+    }
+
+    // 把所有空闲Span中的页归还给操作系统（物理内存），返回归还的页数
+    size_t releaseFreeMemory();
+    // 设置自动归还的速率（字节/秒）以及空闲多久（毫秒）的Span才会被归还，速率为0表示不自动归还
+    // 自动归还在releaseSpan时进行，不额外启动线程
+    void setReleaseRate(size_t bytesPerSecond, size_t idleMilliseconds = 1000);
+    // 大页模式（默认关闭）：之后向系统申请的内存都是2MB对齐、大小为2MB整数倍的区域，Span从这些区域中切分
+    // 优先使用hugetlbfs大页（MAP_HUGETLB），没有可用的大页时使用透明大页（MADV_HUGEPAGE）
+    // 只影响之后新申请的内存，已有的空闲页不变
+    void setHugePageMode(bool enable);
+
+    // 统计信息：向系统申请内存（mmap/mprotect）的次数、空闲页数、已归还给操作系统的空闲页数以及最大的空闲Span页数
+    size_t getSystemAllocCount();
+    size_t getFreePages();
+    size_t getReleasedPages();
+    size_t getLargestFreeSpan();
+    // Span元数据向系统申请的字节数
+    size_t getMetadataBytes();
+    // PageCache锁的争用统计
+    LockStats& getLockStats() { return lockStats_; }
+    // 大页模式下通过MAP_HUGETLB申请到的区域数量
+    size_t getHugetlbAllocCount();
+    // discardSpan丢弃的页数，这些页不会再交给任何人使用
+    size_t getLostPages();
 private:
-    // 默认构造函数，即：
-    // PageCache() {}
-    PageCache() = default;
+    // 默认构造函数，空闲链表初始化为只有哨兵节点的环形链表
+    PageCache() {
+        for(auto& list : freeLists_) {
+            listInit(&list);
+        }
+        listInit(&largeList_);
+        mutex_.setStats(&lockStats_);
+        reserveAddressSpace();
+    }
 
-    // 系统内存申请
+    // 预留RESERVE_BYTES的虚拟地址空间（PROT_NONE），失败时之后的申请直接mmap
+    void reserveAddressSpace();
+    // 向系统申请至少numPages页（大页模式下为2MB的整数倍），作为空闲Span插入空闲链表
+    bool growHeap(size_t numPages);
+    // 系统内存申请：大页模式下优先使用hugetlbfs大页，其次从预留范围中切分，预留范围用完时直接mmap
     void* systemAllocate(size_t numPages);
-private:
+    // 大页模式下提示内核用透明大页映射[ptr, ptr + size)，ptr和size都是2MB对齐的
+    void adviseHugePages(void* ptr, size_t size);
+    // 把新申请的（清零的）内存作为空闲Span插入空闲链表，并和左右相邻的空闲Span合并
+    bool addFreeRegion(void* ptr, size_t numPages);
+    // 和左右相邻的空闲Span合并，合并之后只要有一部分不是0，整个Span就按不是0处理
+    void coalesce(Span* span);
 
-    // Span结构体定义，用于构建链表
-    struct Span {
-        void* pageAddr;  //Span内存开始地址
-        size_t numPages; //Span包含的Page数量
-        Span* next;      //next指针指向下一个Span
-    };
+    // 把Span包含的所有页都映射到这个Span
+    void registerSpan(Span* span);
+
+    // 把空闲Span插入到对应页数的空闲链表，并映射首尾两页，用于和左右相邻的Span合并
+    void insertFreeSpan(Span* span);
+    // 从空闲链表中摘除Span
+    void removeFreeSpan(Span* span);
+    // 从空闲链表中查找页数大于等于numPages的Span
+    Span* findFreeSpan(size_t numPages);
+
+    // 按照自动归还速率，归还空闲时间足够长的Span
+    void incrementalRelease();
+    // 归还最多maxPages页、在idleBefore之前进入空闲链表的Span，返回归还的页数
+    size_t releasePages(size_t maxPages, std::chrono::steady_clock::time_point idleBefore);
+private:
 
-    std::map<size_t, Span*> pageNumToSpan_; //不同的pageNum映射到不同的Span链表，每一个pageNumToSpan_[pageNum]表示对应Span链表的头节点
-    std::map<void*, Span*> addressToSpan_; //地址（指针）到Span的映射，在合并相邻空闲Span的时候会用上
-    std::mutex mutex_; // 互斥锁，用于对PageCache的互斥访问
+    std::array<Span, MAX_PAGES> freeLists_; //freeLists_[n]为页数为n的空闲Span链表的哨兵节点
+    Span largeList_; //页数大于等于MAX_PAGES的空闲Span链表的哨兵节点
+    // 页号到Span的映射（基数树），已分配的Span映射所有页，空闲的Span只映射首尾两页，在合并相邻空闲Span的时候会用上
+    PageMap<ADDRESS_BITS - PAGE_SHIFT> pageMap_;
+    // Span结构体的分配器，不经过全局堆，避免在持有mutex_时调用new/delete
+    MetadataAllocator<Span> spanAllocator_;
+    size_t systemAllocCount_ = 0; // 向系统申请内存的次数
+    size_t freePages_ = 0; // 空闲链表中的总页数
+    size_t releasedPages_ = 0; // 空闲链表中已归还给操作系统的页数
+    size_t releaseRate_ = 0; // 自动归还速率（字节/秒）
+    std::chrono::milliseconds releaseIdle_{1000}; // 空闲多久的Span才会被自动归还
+    std::chrono::steady_clock::time_point lastReleaseTime_; // 上一次自动归还的时间
+    char* reserveStart_ = nullptr; // 预留的虚拟地址范围[reserveStart_, reserveEnd_)
+    char* reserveEnd_ = nullptr;
+    char* bumpPtr_ = nullptr; // 预留范围中下一个还没有切分出去的地址
+    char* commitEnd_ = nullptr; // 预留范围中已经设置为可读写的部分的末尾
+    bool hugePageMode_ = false; // 是否开启大页模式
+    bool hugetlbAvailable_ = true; // MAP_HUGETLB失败过一次之后不再尝试
+    size_t hugetlbAllocCount_ = 0; // 通过MAP_HUGETLB申请到的区域数量
+    size_t lostPages_ = 0; // discardSpan丢弃的页数
+    std::atomic<size_t> remapCount_{0}; // movePages调用mremap的次数，movePages不加锁
+    AdaptiveLock mutex_; // 互斥锁，用于对PageCache的互斥访问
+    LockStats lockStats_;
 };
 
 }// namespace myMemoryPool
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace myMemoryPool {
+
+// 两层基数树，把页号映射到对应的值（Span*），BITS为页号的位数
+// 读操作不加锁：只会读取调用者自己持有的内存所在页的映射，这些映射在内存交给调用者之前就已经写好
+// 写操作（set/ensure）由调用者加锁保证互斥
+template <size_t BITS>
+class PageMap {
+public:
+    constexpr PageMap() = default;
+
+    void* get(size_t pageId) const {
+        size_t i1 = pageId >> LEAF_BITS;
+        size_t i2 = pageId & (LEAF_LENGTH - 1);
+        if((pageId >> BITS) > 0 || root_[i1] == nullptr) {
+            return nullptr;
+        }
+        return root_[i1]->values[i2];
+    }
+
+    // 调用之前必须先用ensure保证对应的叶子节点已经分配
+    void set(size_t pageId, void* value) {
+        size_t i1 = pageId >> LEAF_BITS;
+        size_t i2 = pageId & (LEAF_LENGTH - 1);
+        root_[i1]->values[i2] = value;
+    }
+
+    // 保证[start, start + n)范围内的页号对应的叶子节点都已经分配
+    bool ensure(size_t start, size_t n) {
+        for(size_t key = start; key <= start + n - 1;) {
+            size_t i1 = key >> LEAF_BITS;
+            if(i1 >= ROOT_LENGTH) return false;
+
+            if(root_[i1] == nullptr) {
+                // 叶子节点直接向系统申请，不经过全局堆；mmap得到的内存已经清零
+                void* leaf = mmap(nullptr, sizeof(Leaf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(leaf == MAP_FAILED) return false;
+                root_[i1] = static_cast<Leaf*>(leaf);
+            }
+
+            // 跳到下一个叶子节点覆盖的范围
+            key = ((key >> LEAF_BITS) + 1) << LEAF_BITS;
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t ROOT_BITS = BITS / 2;
+    static constexpr size_t ROOT_LENGTH = size_t(1) << ROOT_BITS;
+    static constexpr size_t LEAF_BITS = BITS - ROOT_BITS;
+    static constexpr size_t LEAF_LENGTH = size_t(1) << LEAF_BITS;
+
+    struct Leaf {
+        void* values[LEAF_LENGTH];
+    };
+
+    Leaf* root_[ROOT_LENGTH] = {}; // 根节点，按需分配叶子节点
+};
+
+} // namespace myMemoryPool
@@ -0,0 +1,32 @@
+#pragma once
+#include "Common.h"
+#include <atomic>
+
+namespace myMemoryPool {
+
+// 线程的远程释放队列：其他线程释放的、属于这个线程的内存块按size class压入无锁栈，由所属线程在本地链表未命中时整体取走
+// 多个线程同时压入，取出时用exchange一次取走整个链表，不存在CAS的ABA问题
+// 队列对象从不释放，线程退出后交给之后新建的线程复用；等待复用期间标记为orphaned，其他线程不再压入，
+// 标记之前刚好压入的少量内存块由之后释放到这个队列的线程（或者复用队列的新线程）取走
+struct RemoteFreeQueue {
+    std::array<std::atomic<void*>, FREE_LIST_SIZE> heads; // 每个size class一个无锁栈的栈顶
+    RemoteFreeQueue* nextFree; // 空闲（等待复用）时所在链表的next指针
+    std::atomic<bool> orphaned; // 所属线程已经退出，队列等待复用
+
+    // 压入一个index对应size class的内存块，next指针写在内存块的前8个字节
+    void push(size_t index, void* ptr) {
+        void* head = heads[index].load(std::memory_order_relaxed);
+        do {
+            *reinterpret_cast<void**>(ptr) = head;
+        } while(!heads[index].compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // 取走index对应size class的所有内存块，返回nullptr结尾的链表
+    void* takeAll(size_t index) {
+        // 先用普通读判断，队列为空时不写共享的cache line
+        if(!heads[index].load(std::memory_order_relaxed)) return nullptr;
+        return heads[index].exchange(nullptr, std::memory_order_acquire);
+    }
+};
+
+} // namespace myMemoryPool
@@ -1,8 +1,24 @@
 #pragma once
 #include "Common.h"
+#include "RemoteFreeQueue.h"
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
 
 namespace myMemoryPool {
 
+struct ThreadCacheCleaner;
+
+// 所有存活线程的ThreadCache统计信息
+struct ThreadCacheStats {
+    size_t threadCount; // 注册过的存活线程数
+    size_t cachedBytes; // 所有线程缓存的内存块总字节数
+    size_t maxThreadBytes; // 单个线程缓存的最大字节数
+    size_t budgetBytes; // 所有线程共享的缓存总预算
+    ptrdiff_t unclaimedBytes; // 还没有分给任何线程的预算，线程数很多时可能为负（每个线程至少分到MIN_THREAD_BYTES）
+};
+
 class ThreadCache {
 public:
     static ThreadCache* getInstance() {
@@ -12,24 +28,161 @@ public:
 
     // 提供的对外接口，分配size大小的内存
     void* allocate(size_t size);
+    // 分配size大小并清零的内存（calloc），刚从系统申请的大对象不再重复清零
+    void* allocateZeroed(size_t size);
+    // 分配size大小、起始地址按alignment对齐的内存，alignment必须是2的幂，否则返回nullptr
+    // alignment小于页大小时由内存块大小是alignment整数倍的size class提供，否则直接由PageCache分配按alignment对齐的Span
+    void* allocateAligned(size_t size, size_t alignment);
     // 释放ptr开始的size大小的内存
     void release(void* ptr, size_t size);
+    // 释放allocateAligned分配的内存，size和alignment与分配时相同
+    void releaseAligned(void* ptr, size_t size, size_t alignment);
+    // 释放ptr开始的内存，size class通过PageCache的页表查出，比带size的版本多一次查表
+    void release(void* ptr);
+    // 把allocate分配的、oldSize大小的内存调整为newSize（realloc），返回调整之后的地址，失败时返回nullptr并且原来的内存不变
+    // 新的大小仍在原来的size class中时直接返回ptr；大对象优先原地扩展到右边相邻的空闲页，
+    // 不超过MREMAP_BYTES时复制数据，更大的缓冲区用mremap移动物理页
+    void* reallocate(void* ptr, size_t oldSize, size_t newSize);
+    // ptr所在内存块实际可用的字节数（size class的大小或者大对象Span的剩余页），ptr不是内存池分配的内存时返回0
+    static size_t usableSize(const void* ptr);
+
+    // 本线程缓存的内存块总字节数以及本线程允许缓存的字节数上限
+    size_t cachedBytes() const { return cachedBytes_.load(std::memory_order_relaxed); }
+    size_t maxBytes() const { return maxBytes_.load(std::memory_order_relaxed); }
+    // 本线程小对象的分配次数以及其中本地链表未命中（需要向CentralCache申请）的次数
+    size_t allocCount() const { return allocCount_; }
+    size_t missCount() const { return missCount_; }
+    // 遍历全局注册表统计所有存活线程缓存的内存，其他线程的缓存字节数不加锁读取，结果是近似值
+    static ThreadCacheStats getStats();
+
+    // 远程释放模式（默认关闭）：释放其他线程申请的内存块时，按内存块所在Span的owner压入所属线程的远程释放队列，
+    // 所属线程在本地链表未命中时整体取走，生产者/消费者模式下内存回到申请的线程，而不是滞留在释放的线程中
+    // 多一次页表查询，只在开启时进行；per-CPU模式下不生效
+    static void setRemoteFree(bool enable) { remoteFree_.store(enable, std::memory_order_relaxed); }
+    static bool remoteFreeEnabled() { return remoteFree_.load(std::memory_order_relaxed); }
+    // 本线程压入其他线程远程释放队列的内存块数量以及从自己的远程释放队列中取回的内存块数量
+    size_t remoteFreeCount() const { return remoteFreeCount_; }
+    size_t remoteDrainCount() const { return remoteDrainCount_; }
+    // 本线程allocateZeroed因为内存一定为0而跳过清零的次数
+    size_t zeroSkipCount() const { return zeroSkipCount_; }
+
+    // 设置所有线程缓存共享的字节数预算（默认DEFAULT_BUDGET），已有线程的上限在之后的窃取中逐渐偿还超出的部分
+    // 所有线程的上限之和不超过预算加上每个线程的MIN_THREAD_BYTES，每个线程缓存的字节数不超过自己的上限
+    static void setBudget(size_t bytes);
+
+    // 所有线程缓存默认的总预算
+    static constexpr size_t DEFAULT_BUDGET = 32 * 1024 * 1024;
+    // 每个线程的缓存上限不低于MIN_THREAD_BYTES，从其他线程窃取预算时每次STEAL_BYTES
+    static constexpr size_t MIN_THREAD_BYTES = 512 * 1024;
+    static constexpr size_t STEAL_BYTES = 64 * 1024;
+    // 增大上限失败（注册表的锁正被占用或者没有可以窃取的预算）之后，接下来STEAL_BACKOFF次scavenge不再尝试
+    static constexpr uint32_t STEAL_BACKOFF = 16;
+    // 单个size class的链表长度上限的最大值
+    static constexpr size_t MAX_LIST_LENGTH = 8192;
+    // 内存块不超过256字节的size class在链表前面使用指针数组（弹匣）缓存，每个弹匣最多MAGAZINE_SIZE个内存块
+    static constexpr size_t MAGAZINE_CLASSES = SMALL_CLASS_NUM + CLASSES_PER_DOUBLING;
+    static constexpr size_t MAGAZINE_SIZE = MAX_BATCH_NUM;
+    // 需要移动的大对象至少有MREMAP_BYTES时用mremap移动物理页代替复制
+    // 每次mremap都会拆分预留范围的映射，只有复制代价明显更高的缓冲区才值得移动
+    static constexpr size_t MREMAP_BYTES = 64 * 1024 * 1024;
 private:
-    // 线程本地的链表和链表长度数组分别初始化为全nullptr以及全0
-    ThreadCache() {
-        freeList_.fill(nullptr);
-        freeListSize_.fill(0);
+    friend struct ThreadCacheCleaner;
+
+    // 所有成员都是零初始化，thread_local实例属于常量初始化，线程第一次分配时无需执行构造函数填充数组
+    ThreadCache() = default;
+
+    // 修改本线程缓存的字节数，只能由本线程调用
+    void addCachedBytes(size_t bytes) {
+        cachedBytes_.store(cachedBytes_.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
     }
+    void subCachedBytes(size_t bytes) {
+        cachedBytes_.store(cachedBytes_.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+    }
+
+    // 从index对应的弹匣/链表中分配内存块，不够时向CentralCache申请
+    // zeroed不为nullptr时，返回的内存块是从清零的Span中新切分出来的（内容一定为0）时置为true
+    void* allocateIndex(size_t index, bool* zeroed = nullptr);
+    // 释放index对应size class的内存块，远程释放模式下按所属线程归还
+    void releaseIndex(void* ptr, size_t index);
+    // ThreadCache本地index对应的链表内存块不够，向CentralCache批量申请，同时增大链表长度上限
+    void* fetchFromCentralCache(size_t index, bool* zeroed = nullptr);
+    // 把内存块挂到index对应的线程本地链表，per-CPU模式下交给当前CPU的缓存
+    void releaseToList(void* ptr, size_t index);
+    // 远程释放模式下owner不是本线程并且没有退出时压入owner的远程释放队列，返回true，否则返回false
+    bool releaseRemote(void* ptr, RemoteFreeQueue* owner, size_t index);
+    // 取走本线程远程释放队列中index对应的内存块，第一个返回，剩下的挂到线程本地链表，队列为空时返回nullptr
+    void* drainRemote(size_t index);
+    // 从index对应的弹匣顶部取下num个内存块归还给CentralCache
+    void returnMagazine(size_t index, size_t num);
+    // 从index对应的线程本地链表头部取下num个内存块归还给CentralCache
+    void returnToCentralCache(size_t index, size_t num);
+    // 从index对应的弹匣底部/线程本地链表尾部（最早放入、最冷的部分）取下num个内存块归还给CentralCache
+    void returnMagazineBottom(size_t index, size_t num);
+    void returnListTail(size_t index, size_t num);
+    // 链表长度超过上限：归还一个批次，多次超过上限时缩小上限
+    void listTooLong(size_t index);
+    // 缓存的字节数超过本线程的上限：缩小缓存，再尝试增大本线程的上限
+    void scavenge();
+    // 每个弹匣和链表归还最冷的一半
+    void shrink();
+    // 从未分配的预算或者其他线程上限中没有用到的部分取出STEAL_BYTES加到本线程的上限，
+    // 预算已经超支（未分配的预算为负）时取到的部分用于偿还超支，本线程的上限不变
+    // 只尝试获取注册表的锁，锁被占用或者没有取到预算时返回false
+    bool increaseCacheLimit();
 
-    // ThreadCache本地size大小对应的链表内存块不够，向CentralCache申请
-    void* fetchFromCentralCache(size_t size);
-    // ThreadCache向CentralCache归还size大小对应的线程本地内存块（当线程本地size大小对应的链表内存块大于一定数量(threshold)时触发）
-    void returnToCentralCache(void* start, size_t size);
+    // 线程第一次缓存内存块时加入全局注册表，并注册线程退出时的清理
+    void registerThread();
+    // 线程退出时把所有缓存的内存块分批归还给CentralCache，并从全局注册表中移除
+    void destroy();
 
 private:
-    // 下面的两个变量没有使用原子结构，和CentralCache中不一样，因为这是线程本地的，不存在线程之间的竞争，无需使用原子结构和互斥锁/自旋锁
-    std::array<void*, FREE_LIST_SIZE> freeList_; //线程本地内存块链表数组，每一个freeList_[i]对应一个链表的头节点   
-    std::array<size_t, FREE_LIST_SIZE> freeListSize_; //线程本地内存块长度数组
+    // 每个size class在线程本地的链表，链表头、长度以及长度上限放在一起，一次访问只涉及同一条cache line
+    // maxLength为0表示该size class在本线程中还没有使用过，第一次未命中时才开始慢启动
+    struct FreeList {
+        void* head = nullptr; //链表头节点
+        uint32_t size = 0; //链表长度
+        uint16_t maxLength = 0; //链表长度上限：未命中时增大（不足一个批次时每次加一，之后每次加一个批次），超过上限的次数过多时缩小
+        uint16_t overages = 0; //达到一个批次之后，链表长度超过上限的次数
+    };
+
+    // 小对象的弹匣：push/pop只读写线程本地的数组，不访问内存块本身，复用cache中已经没有的内存块时不会先产生一次cache未命中
+    // 弹匣满了之后释放的内存块挂到链表中，链表作为弹匣的溢出部分；未命中时从CentralCache申请的批次直接写入弹匣
+    struct Magazine {
+        uint32_t count = 0; //弹匣中的内存块数量
+        void* slots[MAGAZINE_SIZE] = {};
+    };
+    std::array<Magazine, MAGAZINE_CLASSES> magazines_{};
+
+    // 没有使用原子结构，和CentralCache中不一样，因为这是线程本地的，不存在线程之间的竞争，无需使用原子结构和互斥锁/自旋锁
+    std::array<FreeList, FREE_LIST_SIZE> freeList_{}; //线程本地内存块链表数组，每一个freeList_[i]对应一个size class
+
+    // 本线程缓存的内存块总字节数：只有本线程修改，getStats和窃取预算的线程会读取，所以是原子变量
+    // 修改时用relaxed的读+写（addCachedBytes/subCachedBytes）而不是原子加法，x86上和普通变量的开销一样
+    std::atomic<size_t> cachedBytes_{0};
+    std::atomic<size_t> maxBytes_{0}; // 本线程允许缓存的字节数上限，其他线程窃取预算时会修改
+    // 其他线程窃取预算时发现本线程的上限已经用满，请求本线程在下一次未命中时缩小缓存，腾出可以窃取的部分
+    std::atomic<bool> trimRequested_{false};
+    uint32_t stealBackoff_ = 0; // 还要跳过多少次scavenge中的increaseCacheLimit
+    size_t allocCount_ = 0; // 小对象分配次数
+    size_t missCount_ = 0; // 本地链表未命中次数
+    RemoteFreeQueue* remote_ = nullptr; // 本线程的远程释放队列，注册时分配
+    size_t remoteFreeCount_ = 0; // 压入其他线程远程释放队列的内存块数量
+    size_t remoteDrainCount_ = 0; // 从远程释放队列中取回的内存块数量
+    size_t zeroSkipCount_ = 0; // allocateZeroed跳过清零的次数
+
+    bool registered_ = false; // 是否已经加入全局注册表
+    ThreadCache* nextThread_ = nullptr; // 全局注册表（双向链表）中的前后节点
+    ThreadCache* prevThread_ = nullptr;
+
+    static std::mutex registryMutex_; // 保护全局注册表
+    static ThreadCache* registryHead_; // 全局注册表的头节点
+    // 以下由registryMutex_保护
+    static size_t budget_; // 所有线程缓存的总预算
+    static ptrdiff_t unclaimedBudget_; // 还没有分给任何线程的预算
+    static ThreadCache* stealCursor_; // 下一次窃取预算的线程，轮流窃取
+    static RemoteFreeQueue* freeQueues_; // 退出的线程留下的远程释放队列，等待复用
+
+    static std::atomic<bool> remoteFree_; // 是否开启远程释放模式
 };
 
 }// namespace myMemoryPool
\ No newline at end of file
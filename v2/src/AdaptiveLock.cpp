@@ -0,0 +1,105 @@
+#include "../include/AdaptiveLock.h"
+#include <chrono>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace myMemoryPool {
+
+// 自旋阶段每轮pause的次数从1开始翻倍，超过MAX_SPIN之后进入睡眠
+static const size_t MAX_SPIN = 64;
+
+std::atomic<bool> AdaptiveLock::profiling_{false};
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 纳秒数对应的直方图桶
+static size_t bucketOf(uint64_t ns) {
+    size_t bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    return bucket < LockStats::BUCKETS ? bucket : LockStats::BUCKETS - 1;
+}
+
+void AdaptiveLock::lockSlow() {
+    if(stats_) stats_->contended.fetch_add(1, std::memory_order_relaxed);
+
+    // 有界的指数退避自旋：持有锁的线程正在运行时，临界区很短，很快就能拿到锁
+    for(size_t spins = 1; spins <= MAX_SPIN; spins <<= 1) {
+        for(size_t i = 0; i < spins; i ++) {
+            cpuRelax();
+        }
+        uint32_t expected = UNLOCKED;
+        if(state_.load(std::memory_order_relaxed) == UNLOCKED 
+            && state_.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    // 自旋失败，把状态改为PARKED后睡眠，直到解锁时被唤醒；拿到锁时状态保持PARKED，解锁时多唤醒一次也没有问题
+    if(stats_) stats_->parked.fetch_add(1, std::memory_order_relaxed);
+    while(state_.exchange(PARKED, std::memory_order_acquire) != UNLOCKED) {
+        syscall(SYS_futex, &state_, FUTEX_WAIT_PRIVATE, PARKED, nullptr, nullptr, 0);
+    }
+}
+
+void AdaptiveLock::lockProfiled() {
+    uint64_t start = nowNs();
+    uint32_t expected = UNLOCKED;
+    if(!state_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+        lockSlow();
+    }
+    acquiredAt_ = nowNs();
+    if(stats_) stats_->waitNs[bucketOf(acquiredAt_ - start)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void AdaptiveLock::recordHold() {
+    if(stats_) stats_->holdNs[bucketOf(nowNs() - acquiredAt_)].fetch_add(1, std::memory_order_relaxed);
+    acquiredAt_ = 0;
+}
+
+void AdaptiveLock::wake() {
+    syscall(SYS_futex, &state_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void LockStats::reset() {
+    contended.store(0, std::memory_order_relaxed);
+    parked.store(0, std::memory_order_relaxed);
+    for(size_t i = 0; i < BUCKETS; i ++) {
+        waitNs[i].store(0, std::memory_order_relaxed);
+        holdNs[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LockStats::total(const std::array<std::atomic<size_t>, BUCKETS>& histogram) {
+    size_t count = 0;
+    for(const auto& bucket : histogram) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+size_t LockStats::percentile(const std::array<std::atomic<size_t>, BUCKETS>& histogram, double p) {
+    size_t count = total(histogram);
+    if(count == 0) return 0;
+
+    size_t target = static_cast<size_t>(p * (count - 1)) + 1;
+    size_t seen = 0;
+    for(size_t i = 0; i < BUCKETS; i ++) {
+        seen += histogram[i].load(std::memory_order_relaxed);
+        if(seen >= target) return size_t(2) << i;
+    }
+    return size_t(2) << (BUCKETS - 1);
+}
+
+} // namespace myMemoryPool
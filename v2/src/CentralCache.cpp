@@ -1,118 +1,308 @@
 #include "../include/CentralCache.h"
 #include "../include/PageCache.h"
-#include <cassert>
-#include <thread>
+#include "../include/CpuCache.h"
+#include <unistd.h>
 
 namespace myMemoryPool {
 
 // 每次从PageCache获取的Span页数最小值(单位为页)
 static const size_t SPAN_PAGES = 8;
 
-void* CentralCache::fetchMemory(size_t index) {
-    if(index >= FREE_LIST_SIZE) return nullptr;
+size_t CentralCache::fetchRange(void** batch, size_t batchNum, size_t index, RemoteFreeQueue* owner, uint32_t* zeroedMask) {
+    if(index >= FREE_LIST_SIZE || batchNum == 0) return 0;
 
-    // test_and_set尝试获取锁，如果锁被占用，返回true，一直在while等
-    while(locks_[index].test_and_set(std::memory_order_acquire)) {
-        // 让当前线程主动放弃CPU执行权，避免忙等待
-        std::this_thread::yield();
+    // 先从转移缓存中取，只复制指针
+    size_t count = 0;
+    if(transferable(index)) {
+        count = removeTransfer(index, batch, batchNum);
+        if(count == batchNum) {
+            transferHitCount_.fetch_add(1, std::memory_order_relaxed);
+            fetchedBlockCount_.fetch_add(count, std::memory_order_relaxed);
+            return count;
+        }
     }
 
-    void* result = nullptr;
-    
-    try {
-        // atomic变量获取值用load + std::memory_order_acquire
-        result = centralFreeList_[index].load(std::memory_order_acquire);
-        
-        // CentralCache没有对应大小的内存块，就向PageCache申请
-        if(!result) {
-            // 由于index从0开始，因此要加1
-            size_t size = (index + 1) * ALIGNMENT;
-            result = fetchFromPageCache(size);
-            
-            if(!result) {
-                locks_[index].clear(std::memory_order_release);
-                return nullptr;
-            }
+    size_t shard = currentShard();
+
+    // 再从当前CPU对应的分片中取，只有一个分片时没有可以窃取的，不够直接向PageCache申请
+    lock(shard, index);
+    takeFromSpans(shard, index, batch, count, batchNum, owner, zeroedMask);
+    if(numShards_ == 1) {
+        fillFromPageCache(shard, index, batch, count, batchNum, owner, zeroedMask);
+    }
+    unlock(shard, index);
+
+    // 本地分片没有空闲内存块了，向PageCache申请之前先从其他分片窃取
+    for(size_t i = 1; i < numShards_ && count < batchNum; i ++) {
+        size_t victim = (shard + i) % numShards_;
+        size_t before = count;
+        lock(victim, index);
+        takeFromSpans(victim, index, batch, count, batchNum, owner, zeroedMask);
+        unlock(victim, index);
+        if(count > before) {
+            stealCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // 所有分片都不够，向PageCache申请新的Span放入本地分片
+    if(count < batchNum) {
+        lock(shard, index);
+        takeFromSpans(shard, index, batch, count, batchNum, owner, zeroedMask);
+        fillFromPageCache(shard, index, batch, count, batchNum, owner, zeroedMask);
+        unlock(shard, index);
+    }
+
+    fetchedBlockCount_.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+void CentralCache::fillFromPageCache(size_t shard, size_t index, void** batch, size_t& count, size_t batchNum, RemoteFreeQueue* owner, uint32_t* zeroedMask) {
+    while(count < batchNum) {
+        // CentralCache没有还有空闲内存块的Span，就向PageCache申请
+        PageCache::Span* newSpan = fetchFromPageCache(index);
+        if(!newSpan) break;
+        newSpan->shard = shard;
+        PageCache::listPush(&shards_[shard].spanLists[index], newSpan);
+        takeFromSpans(shard, index, batch, count, batchNum, owner, zeroedMask);
+    }
+}
 
-            char* start = static_cast<char*>(result);
-            
-            // 当size 大于8*4KB即32KB的时候，blockNum = 0
-            size_t blockNum = (SPAN_PAGES * PageCache::PAGE_SIZE) / size;
-
-            // blockNum = 0/1 的时候直接return result
-            if(blockNum > 1) {
-                // 创建链表
-                for(size_t i = 1; i < blockNum; i ++) {
-                    void* cur = start + (i - 1) * size;
-                    void* next = start + i * size;
-                    // 相当于结构体链表中的cur->next
-                    *reinterpret_cast<void**>(cur) = next;
-                }
-                // 最后一个节点的next为nullptr
-                *reinterpret_cast<void**>(start + (blockNum - 1) * size) = nullptr;
-
-                // 把头结点断开，下一个节点next作为链表头结点
-                void* next = *reinterpret_cast<void**>(result);
-                *reinterpret_cast<void**>(result) = nullptr;
-                centralFreeList_[index].store(next, std::memory_order_release);
+void CentralCache::takeFromSpans(size_t shard, size_t index, void** batch, size_t& count, size_t batchNum, RemoteFreeQueue* owner, uint32_t* zeroedMask) {
+    PageCache::Span* list = &shards_[shard].spanLists[index];
+
+    while(count < batchNum && !PageCache::listEmpty(list)) {
+        // 先从Span的空闲链表中取下归还回来的内存块（已经访问过，大概率还在cache中），依次写入batch
+        PageCache::Span* span = list->next;
+        span->owner.store(owner, std::memory_order_relaxed);
+        while(count < batchNum && span->freeList) {
+            void* block = span->freeList;
+            span->freeList = *reinterpret_cast<void**>(block);
+            batch[count ++] = block;
+            span->useCount ++;
+        }
+
+        // 空闲链表不够时再从还没有切分的部分按顺序切分，只移动指针，不写内存块
+        // 清零的Span中还没有切分的部分从来没有被写过，切分出来的内存块一定为0
+        size_t size = SizeClass::classSize(index);
+        while(count < batchNum && span->carvePtr != span->carveEnd) {
+            if(zeroedMask && span->isZeroed) {
+                *zeroedMask |= uint32_t(1) << count;
             }
-        } else {
-            // CentralCache有对应大小的内存，直接把头结点返回，next作为新链表的头节点
-            void* next = *reinterpret_cast<void**>(result);
-            *reinterpret_cast<void**>(result) = nullptr;
-            centralFreeList_[index].store(next, std::memory_order_release);
+            batch[count ++] = span->carvePtr;
+            span->carvePtr += size;
+            span->useCount ++;
         }
 
-    } catch(...) {
-        // 解锁使用clear + std::memeory_order_release
-        locks_[index].clear(std::memory_order_release);
-        throw;
+        // Span中的内存块全部分配出去了，从Span链表中摘除，归还内存块时再挂回来
+        if(!hasFreeBlocks(span)) {
+            PageCache::listRemove(span);
+        }
     }
+}
+
+void CentralCache::returnMemory(void** batch, size_t count, size_t index) {
+    if(count == 0 || index >= FREE_LIST_SIZE) return;
 
-    // 解锁使用clear + std::memeory_order_release
-    locks_[index].clear(std::memory_order_release);
-    return result;
+    // 优先放入转移缓存，转移缓存满了的部分加锁归还给Span
+    size_t inserted = transferable(index) ? insertTransfer(index, batch, count) : 0;
+    if(inserted < count) {
+        returnToSpans(batch + inserted, count - inserted, index);
+    }
 }
 
 void CentralCache::returnMemory(void* start, size_t index) {
-    if(!start || index >= FREE_LIST_SIZE) return;
+    void* batch[MAX_BATCH_NUM];
+    while(start) {
+        size_t count = 0;
+        while(count < MAX_BATCH_NUM && start) {
+            batch[count ++] = start;
+            start = *reinterpret_cast<void**>(start);
+        }
+        returnMemory(batch, count, index);
+    }
+}
 
-    while(locks_[index].test_and_set(std::memory_order_acquire)) {
-        std::this_thread::yield();
+size_t CentralCache::flush() {
+    size_t total = 0;
+    void* batch[MAX_BATCH_NUM];
+    for(size_t index = 0; index < FREE_LIST_SIZE; index ++) {
+        if(!transferable(index)) continue;
+
+        while(size_t count = removeTransfer(index, batch, MAX_BATCH_NUM)) {
+            returnToSpans(batch, count, index);
+            total += count;
+        }
     }
+    return total;
+}
+
+void CentralCache::returnToSpans(void** batch, size_t count, size_t index) {
+    PageCache& pageCache = PageCache::getInstance();
+    // 当前持有锁的分片，相邻的内存块大多属于同一个分片，不需要反复加锁
+    size_t locked = MAX_SHARDS;
+
+    // 每个内存块通过页表找到所属的Span，头插法插入到Span的空闲链表
+    for(size_t i = 0; i < count; i ++) {
+        void* block = batch[i];
+        PageCache::Span* span = pageCache.getSpan(block);
+
+        // Span只能在所在分片的锁保护下修改
+        if(span->shard != locked) {
+            if(locked != MAX_SHARDS) unlock(locked, index);
+            locked = span->shard;
+            lock(locked, index);
+        }
 
-    try {
+        // Span之前没有空闲内存块，不在Span链表中，重新挂回来
+        if(!hasFreeBlocks(span)) {
+            PageCache::listPush(&shards_[locked].spanLists[index], span);
+        }
+        *reinterpret_cast<void**>(block) = span->freeList;
+        span->freeList = block;
 
-        // 由于要归还的是一条链表，因此进行头插法的话要找到这条链表的尾节点
-        void* end = start;
-        
-        while(*reinterpret_cast<void**>(end) != nullptr) {
-            end = *reinterpret_cast<void**>(end);
+        // Span中的内存块全部归还了，把整个Span归还给PageCache，可以用于其他size class
+        if(--span->useCount == 0) {
+            PageCache::listRemove(span);
+            span->freeList = nullptr;
+            span->carvePtr = span->carveEnd = nullptr;
+            pageCache.releaseSpan(span->pageAddr, span->numPages);
         }
+    }
+
+    if(locked != MAX_SHARDS) unlock(locked, index);
+}
+
+PageCache::Span* CentralCache::fetchFromPageCache(size_t index) {
+    size_t size = SizeClass::classSize(index);
+    size_t numPages = spanPages(size);
+
+    void* ptr = PageCache::getInstance().allocateSpan(numPages, index);
+    if(!ptr) return nullptr;
+
+    PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+    size_t blockNum = (numPages * PageCache::PAGE_SIZE) / size;
+
+    // 只记录可以切分的范围，内存块在takeFromSpans中按需切分
+    span->freeList = nullptr;
+    span->carvePtr = static_cast<char*>(ptr);
+    span->carveEnd = static_cast<char*>(ptr) + blockNum * size;
+    span->useCount = 0;
+    return span;
+}
+
+bool CentralCache::transferable(size_t index) {
+    return SizeClass::numMoveSize(SizeClass::classSize(index)) > 1;
+}
+
+size_t CentralCache::insertTransfer(size_t index, void** batch, size_t count) {
+    TransferCache& cache = transfer_[index];
+    // 每个批次最多放一个完整批次的内存块，容量为MAX_CACHED_BATCHES个完整批次
+    size_t fullBatch = SizeClass::numMoveSize(SizeClass::classSize(index));
 
-        // 头插法
-        void* cur = centralFreeList_[index].load(std::memory_order_acquire);
-        *reinterpret_cast<void**>(end) = cur;
-        centralFreeList_[index].store(start, std::memory_order_release);
-    } catch (...) {
-        locks_[index].clear(std::memory_order_release);
-        throw;
+    size_t inserted = 0;
+    uint32_t id;
+    // removeTransfer没有取完的批次压回满栈栈顶，先把它补满，否则不满的批次越积越多，转移缓存的实际容量不断下降
+    if(popBatch(cache, cache.full, id)) {
+        TransferBatch& transfer = cache.batches[id];
+        size_t n = std::min(count, fullBatch - std::min<size_t>(transfer.count, fullBatch));
+        std::copy(batch, batch + n, transfer.blocks + transfer.count);
+        transfer.count += static_cast<uint32_t>(n);
+        pushBatch(cache, cache.full, id);
+        inserted = n;
     }
+    while(inserted < count && popBatch(cache, cache.empty, id)) {
+        TransferBatch& transfer = cache.batches[id];
+        size_t n = std::min(count - inserted, fullBatch);
+        std::copy(batch + inserted, batch + inserted + n, transfer.blocks);
+        transfer.count = static_cast<uint32_t>(n);
+        pushBatch(cache, cache.full, id);
+        inserted += n;
+    }
+    return inserted;
+}
 
-    locks_[index].clear(std::memory_order_release);
+size_t CentralCache::removeTransfer(size_t index, void** batch, size_t count) {
+    TransferCache& cache = transfer_[index];
+
+    size_t removed = 0;
+    uint32_t id;
+    while(removed < count && popBatch(cache, cache.full, id)) {
+        TransferBatch& transfer = cache.batches[id];
+        // 取批次最后放入的n个（insertTransfer补满批次时追加在后面，是最近归还的），保持放入时的顺序；
+        // 没有取完的部分留在批次中压回满栈
+        size_t n = std::min<size_t>(count - removed, transfer.count);
+        transfer.count -= static_cast<uint32_t>(n);
+        std::copy(transfer.blocks + transfer.count, transfer.blocks + transfer.count + n, batch + removed);
+        removed += n;
+        if(transfer.count > 0) {
+            pushBatch(cache, cache.full, id);
+        }else {
+            pushBatch(cache, cache.empty, id);
+        }
+    }
+    return removed;
+}
+
+// 栈顶的低32位为批次编号加一，高32位为版本号
+static const uint64_t TAG_SHIFT = 32;
+
+void CentralCache::pushBatch(TransferCache& cache, std::atomic<uint64_t>& top, uint32_t id) {
+    uint64_t oldTop = top.load(std::memory_order_relaxed);
+    uint64_t newTop;
+    do {
+        cache.batches[id].next.store(static_cast<uint32_t>(oldTop), std::memory_order_relaxed);
+        newTop = ((oldTop >> TAG_SHIFT) + 1) << TAG_SHIFT | (id + 1);
+    } while(!top.compare_exchange_weak(oldTop, newTop, std::memory_order_release, std::memory_order_relaxed));
 }
 
-void* CentralCache::fetchFromPageCache(size_t size) {
-    // 向上取整
-    size_t numPages = (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE;
+bool CentralCache::popBatch(TransferCache& cache, std::atomic<uint64_t>& top, uint32_t& id) {
+    // acquire：看到压入批次的线程在压入之前写入的指针
+    uint64_t oldTop = top.load(std::memory_order_acquire);
+    uint64_t newTop;
+    do {
+        uint32_t head = static_cast<uint32_t>(oldTop);
+        if(head == 0) return false;
+        // 读到的next可能已经过期（批次被其他线程弹出又压回），此时版本号不同，CAS失败重试
+        uint64_t next = cache.batches[head - 1].next.load(std::memory_order_relaxed);
+        newTop = ((oldTop >> TAG_SHIFT) + 1) << TAG_SHIFT | next;
+    } while(!top.compare_exchange_weak(oldTop, newTop, std::memory_order_acquire, std::memory_order_acquire));
 
-    // 申请内存小于等于8页，一律按照8页进行分配（多余的可以进行分块，保存在CentralCache）
-    if(size <= SPAN_PAGES * PageCache::PAGE_SIZE) {
-        return PageCache::getInstance().allocateSpan(SPAN_PAGES);
-    }else {
-    // 否则按照实际需要内存大小进行分配
-        return PageCache::getInstance().allocateSpan(numPages);
+    id = static_cast<uint32_t>(oldTop) - 1;
+    return true;
+}
+
+size_t CentralCache::spanPages(size_t size) {
+    // 申请内存小于等于8页，至少按照8页进行分配（多余的可以进行分块，保存在CentralCache）
+    // 否则至少按照实际需要的页数进行分配
+    size_t numPages = std::max(SPAN_PAGES, (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE);
+
+    // Span切分后剩余的尾部不足一个内存块，浪费超过Span的1/8时增加页数
+    while((numPages * PageCache::PAGE_SIZE) % size > (numPages * PageCache::PAGE_SIZE) / 8) {
+        numPages ++;
     }
+    return numPages;
+}
+
+size_t CentralCache::initShardCount() {
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    if(cpus <= 1) return 1;
+    return std::min(static_cast<size_t>(cpus), MAX_SHARDS);
+}
+
+size_t CentralCache::currentShard() const {
+    if(numShards_ == 1) return 0;
+    int cpu = CpuCache::currentCpu();
+    return cpu < 0 ? 0 : static_cast<size_t>(cpu) % numShards_;
+}
+
+void CentralCache::lock(size_t shard, size_t index) {
+    // 锁被占用时先短暂自旋，仍然拿不到就在futex上睡眠，不会yield空转
+    shards_[shard].locks[index].lock();
+    lockAcquireCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CentralCache::unlock(size_t shard, size_t index) {
+    shards_[shard].locks[index].unlock();
 }
 
 } // namespace myMemoryPool
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "../include/CpuCache.h"
+#include "../include/CentralCache.h"
+#include <mutex>
+#include <new>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define MEMORY_POOL_HAVE_RSEQ 1
+#endif
+
+namespace myMemoryPool {
+
+// 每个CPU的链表长度超过阈值时向CentralCache归还，和ThreadCache一致
+static const size_t CPU_THRESHOLD = 64;
+
+// 每个CPU单个size class链表长度的上限：不超过CPU_THRESHOLD，也不超过两个批次，
+// 批次大小按字节数限制，大的size class只缓存几个内存块（256KB最多2个），而不是CPU_THRESHOLD个
+static size_t listLimit(size_t index) {
+    return std::min(CPU_THRESHOLD, 2 * SizeClass::numMoveSize(SizeClass::classSize(index)));
+}
+
+std::atomic<bool> CpuCache::enabled_{false};
+
+int CpuCache::currentCpu() {
+#ifdef MEMORY_POOL_HAVE_RSEQ
+    // glibc 2.35之后每个线程启动时都会注册rseq，cpu_id由内核维护；注册失败时为负数
+    if(__rseq_size > 0) {
+        const struct rseq* area = reinterpret_cast<const struct rseq*>(
+            static_cast<const char*>(__builtin_thread_pointer()) + __rseq_offset);
+        int cpu = static_cast<int>(__atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED));
+        if(cpu >= 0) return cpu;
+    }
+#endif
+    return sched_getcpu();
+}
+
+bool CpuCache::setEnabled(bool enable) {
+    if(!enable) {
+        enabled_.store(false, std::memory_order_relaxed);
+        flush();
+        return true;
+    }
+
+    if(currentCpu() < 0) return false;
+
+    // 只在第一次开启时申请，之后一直保留
+    static std::once_flag once;
+    std::call_once(once, [this]() {
+        long cpus = sysconf(_SC_NPROCESSORS_CONF);
+        size_t num = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+        void* ptr = mmap(nullptr, num * sizeof(Slot), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED) return;
+
+        slots_ = static_cast<Slot*>(ptr);
+        for(size_t i = 0; i < num; i ++) {
+            new (&slots_[i]) Slot();
+        }
+        numCpus_ = num;
+    });
+    if(!slots_) return false;
+
+    enabled_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void* CpuCache::allocate(size_t index) {
+    Slot& slot = lockCurrent();
+
+    FreeList& list = slot.freeList[index];
+    if(void* ptr = list.head) {
+        list.head = *reinterpret_cast<void**>(ptr);
+        list.setLength(list.length() - 1);
+        unlock(slot);
+        return ptr;
+    }
+
+    // 慢启动：同一个size class连续未命中时，批量申请的数量逐渐增大
+    size_t limit = SizeClass::numMoveSize(SizeClass::classSize(index));
+    if(list.maxBatch < limit) {
+        list.maxBatch++;
+    }
+
+    void* batch[MAX_BATCH_NUM];
+    size_t actualNum = CentralCache::getInstance().fetchRange(batch, list.maxBatch, index);
+    if(actualNum == 0) {
+        unlock(slot);
+        return nullptr;
+    }
+    for(size_t i = actualNum - 1; i > 0; i --) {
+        *reinterpret_cast<void**>(batch[i]) = list.head;
+        list.head = batch[i];
+    }
+    list.setLength(list.length() + actualNum - 1);
+    unlock(slot);
+    return batch[0];
+}
+
+void CpuCache::release(void* ptr, size_t index) {
+    Slot& slot = lockCurrent();
+
+    FreeList& list = slot.freeList[index];
+    *reinterpret_cast<void**>(ptr) = list.head;
+    list.head = ptr;
+    list.setLength(list.length() + 1);
+
+    // 链表长度超过上限，保留1/4，剩下的归还给CentralCache
+    if(list.length() >= listLimit(index)) {
+        returnToCentralCache(slot, index, list.length() / 4);
+    }
+    unlock(slot);
+}
+
+size_t CpuCache::flush() {
+    size_t bytes = 0;
+    for(size_t cpu = 0; cpu < numCpus_; cpu ++) {
+        Slot& slot = slots_[cpu];
+        lock(slot);
+        for(size_t index = 0; index < FREE_LIST_SIZE; index ++) {
+            bytes += returnToCentralCache(slot, index, 0) * SizeClass::classSize(index);
+            slot.freeList[index].maxBatch = 0;
+        }
+        unlock(slot);
+    }
+    return bytes;
+}
+
+size_t CpuCache::cachedBytes() const {
+    size_t bytes = 0;
+    for(size_t cpu = 0; cpu < numCpus_; cpu ++) {
+        for(size_t index = 0; index < FREE_LIST_SIZE; index ++) {
+            bytes += slots_[cpu].freeList[index].length() * SizeClass::classSize(index);
+        }
+    }
+    return bytes;
+}
+
+CpuCache::Slot& CpuCache::lockCurrent() {
+    int cpu = currentCpu();
+    Slot& slot = slots_[static_cast<size_t>(cpu) % numCpus_];
+    lock(slot);
+    return slot;
+}
+
+void CpuCache::lock(Slot& slot) {
+    // 同一CPU上只有持有锁的线程被抢占时才会竞争，此时等待者在futex上睡眠
+    slot.lock.lock();
+}
+
+void CpuCache::unlock(Slot& slot) {
+    slot.lock.unlock();
+}
+
+size_t CpuCache::returnToCentralCache(Slot& slot, size_t index, size_t keepNum) {
+    FreeList& list = slot.freeList[index];
+    if(list.length() <= keepNum) return 0;
+
+    // 跳过保留的keepNum个内存块，剩下的一次性归还
+    void* start = list.head;
+    void* last = nullptr;
+    for(size_t i = 0; i < keepNum; i ++) {
+        last = start;
+        start = *reinterpret_cast<void**>(start);
+    }
+    if(last) {
+        *reinterpret_cast<void**>(last) = nullptr;
+    }else {
+        list.head = nullptr;
+    }
+
+    size_t returnNum = list.length() - keepNum;
+    list.setLength(keepNum);
+    CentralCache::getInstance().returnMemory(start, index);
+    return returnNum;
+}
+
+} // namespace myMemoryPool
@@ -0,0 +1,88 @@
+#include "../include/LargeCache.h"
+
+namespace myMemoryPool {
+
+void* LargeCache::allocate(size_t size) {
+    size_t numPages = roundUpPages((size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE);
+
+    if(numPages <= MAX_CACHED_PAGES) {
+        std::lock_guard<AdaptiveLock> lock(mutex_);
+
+        // 优先复用同一档位最近释放的Span
+        PageCache::Span*& bucket = buckets_[bucketIndex(numPages)];
+        if(PageCache::Span* span = bucket) {
+            bucket = span->next;
+            span->next = nullptr;
+            cachedBytes_ -= span->numPages * PageCache::PAGE_SIZE;
+            hitCount_ ++;
+            return span->pageAddr;
+        }
+        missCount_ ++;
+    }
+
+    return PageCache::getInstance().allocateSpan(numPages, LARGE_SIZE_CLASS);
+}
+
+void LargeCache::release(PageCache::Span* span) {
+    PageCache& pageCache = PageCache::getInstance();
+    size_t bytes = span->numPages * PageCache::PAGE_SIZE;
+    // 缓存的Span已经被使用过，再次分配出去时需要清零
+    span->isZeroed = false;
+
+    // 超大的Span以及不超过MAX_BYTES的Span（按页对齐分配的小对象）不缓存，直接归还给PageCache
+    if(span->numPages > MAX_CACHED_PAGES || bytes > MAX_CACHED_BYTES || bytes <= MAX_BYTES) {
+        pageCache.releaseSpan(span->pageAddr, span->numPages);
+        return;
+    }
+
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    // 缓存超出上限时，从最大的桶开始把Span归还给PageCache
+    for(size_t i = BUCKET_NUM; i > 0 && cachedBytes_ + bytes > MAX_CACHED_BYTES; i --) {
+        PageCache::Span*& bucket = buckets_[i - 1];
+        while(bucket && cachedBytes_ + bytes > MAX_CACHED_BYTES) {
+            PageCache::Span* victim = bucket;
+            bucket = victim->next;
+            cachedBytes_ -= victim->numPages * PageCache::PAGE_SIZE;
+            pageCache.releaseSpan(victim->pageAddr, victim->numPages);
+        }
+    }
+
+    PageCache::Span*& bucket = buckets_[bucketIndex(span->numPages)];
+    span->next = bucket;
+    bucket = span;
+    cachedBytes_ += bytes;
+}
+
+size_t LargeCache::flush() {
+    PageCache& pageCache = PageCache::getInstance();
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    size_t pages = 0;
+    for(auto& bucket : buckets_) {
+        while(PageCache::Span* span = bucket) {
+            bucket = span->next;
+            pages += span->numPages;
+            pageCache.releaseSpan(span->pageAddr, span->numPages);
+        }
+    }
+    cachedBytes_ = 0;
+    return pages;
+}
+
+size_t LargeCache::getCachedBytes() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return cachedBytes_;
+}
+
+size_t LargeCache::getHitCount() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return hitCount_;
+}
+
+size_t LargeCache::getMissCount() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return missCount_;
+}
+
+} // namespace myMemoryPool
@@ -1,117 +1,487 @@
 #include "PageCache.h"
 #include <sys/mman.h>
-#include <cstring>
+#include <cstdint>
 
 namespace myMemoryPool {
 
-void* PageCache::allocateSpan(size_t numPages) {
+void* PageCache::allocateSpan(size_t numPages, size_t sizeClass, size_t alignPages) {
     // 进入函数自动lock，离开函数自动unlock
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    // 查找第一个大于等于要求的numPages的项，多余的页可以重新插入到新的链表中
-    auto it = pageNumToSpan_.lower_bound(numPages);
-    if(it != pageNumToSpan_.end()) {
-        Span* span = it->second;
-        
-        // span->next：相同页大小的链表的下一个节点
-        if(span->next) {
-            pageNumToSpan_[it->first] = span->next;
-        }else {
-            // 如果这个页数对应的链表只有一个节点（即头节点），那么从map中直接删除
-            pageNumToSpan_.erase(it);
-        }
-        
-        // 查找的页数过多，需要把多余的重新插入到新的链表中
-        if(span->numPages > numPages) {
-            Span* newSpan = new Span;
-            // span->pageAddr进行加法之前要转换成char*类型
-            newSpan->pageAddr = static_cast<char*>(span->pageAddr) + numPages * PAGE_SIZE;
-            newSpan->numPages = span->numPages - numPages;
-            newSpan->next = nullptr;
-            
-            // 把newSpan插入到剩余页数对应的链表的头部（头插法）
-            auto& list = pageNumToSpan_[newSpan->numPages];
-            newSpan->next = list;
-            list = newSpan;
-
-            span->numPages = numPages;
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    // 需要对齐时多找alignPages - 1页，保证其中一定有一段对齐的numPages页
+    size_t searchPages = numPages + alignPages - 1;
+
+    // 查找第一个页数大于等于要求的searchPages的空闲Span，多余的页可以重新插入到新的链表中
+    Span* span = findFreeSpan(searchPages);
+    if(!span) {
+        // 向系统申请内存，和相邻的空闲Span合并之后再查找一次
+        if(!growHeap(searchPages)) return nullptr;
+        span = findFreeSpan(searchPages);
+    }
+
+    // 对齐的起始页之前跳过的页数
+    size_t skipPages = (alignPages - pageId(span->pageAddr) % alignPages) % alignPages;
+
+    // 查找的页数过多，需要把多余的重新插入到新的链表中，先分配好剩余部分（前面跳过的部分和后面多余的部分）的Span
+    Span* headSpan = nullptr;
+    Span* newSpan = nullptr;
+    if(skipPages > 0) {
+        headSpan = spanAllocator_.allocate();
+        if(!headSpan) return nullptr;
+    }
+    if(span->numPages > skipPages + numPages) {
+        newSpan = spanAllocator_.allocate();
+        if(!newSpan) {
+            if(headSpan) spanAllocator_.deallocate(headSpan);
+            return nullptr;
         }
-        // 记录地址到Span的映射
-        addressToSpan_[span->pageAddr] = span;
-        return span->pageAddr;
     }
-    // 向系统申请内存
-    void* sysMemory = systemAllocate(numPages);
-    if(!sysMemory) return nullptr;
 
-    Span* span = new Span;
-    span->pageAddr = sysMemory;
-    span->numPages = numPages;
-    span->next = nullptr;
+    removeFreeSpan(span);
+
+    if(headSpan) {
+        // 跳过的部分作为空闲Span放回空闲链表，span从对齐的页开始
+        headSpan->pageAddr = span->pageAddr;
+        headSpan->numPages = skipPages;
+        headSpan->isReleased = span->isReleased;
+        headSpan->isZeroed = span->isZeroed;
+        insertFreeSpan(headSpan);
 
-    addressToSpan_[span->pageAddr] = span;
-    return sysMemory;
+        span->pageAddr = static_cast<char*>(span->pageAddr) + skipPages * PAGE_SIZE;
+        span->numPages -= skipPages;
+    }
+
+    if(newSpan) {
+        // span->pageAddr进行加法之前要转换成char*类型
+        newSpan->pageAddr = static_cast<char*>(span->pageAddr) + numPages * PAGE_SIZE;
+        newSpan->numPages = span->numPages - numPages;
+        // 剩余的部分保持原来的归还状态
+        newSpan->isReleased = span->isReleased;
+        newSpan->isZeroed = span->isZeroed;
+        insertFreeSpan(newSpan);
+
+        span->numPages = numPages;
+    }
+    // 已归还给操作系统的页在下一次访问时由内核重新分配（清零的）物理页，无需额外处理
+    span->isReleased = false;
+    span->sizeClass = sizeClass;
+    registerSpan(span);
+    return span->pageAddr;
 }
 
 void PageCache::releaseSpan(void* ptr, size_t numPages) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = addressToSpan_.find(ptr);
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    Span* span = getSpan(ptr);
     // 按道理，通过PageCache申请的内存也是通过PageCache来释放，下面这句可能用不上
-    if(it == addressToSpan_.end()) return;
-
-    Span* span = it->second;
-    // 尝试合并相邻的下一个Span，如果下一个Span也是空闲的话（即在Span链表中）
-    // 注意这里的合并相邻Span只考虑了当前Span和右边的空闲Span合并，没有考虑和左边的Span进行合并
-    void* nextAddr = static_cast<char*>(ptr) + numPages * PAGE_SIZE;
-    auto nextIt = addressToSpan_.find(nextAddr);
-    
-    if(nextIt != addressToSpan_.end()) {
-        Span* nextSpan = nextIt->second;
-
-        bool found = false;
-        auto& nextList = pageNumToSpan_[nextSpan->numPages];
-
-        if(nextList == nextSpan) {
-            nextList = nextSpan->next;
-            found = true;
-            // 删除map中的映射？
-            // pageNumToSpan_.erase(nextSpan->numPages);
-        }else if(nextList) {
-            // 找到nextSpan并删除
-            Span* prev = nextList;
-            while(prev->next) {
-                if(prev->next == nextSpan) {
-                    prev->next = nextSpan->next;
-                    found = true;
-                    break;
-                }
-                prev = prev->next;
-            }
+    if(!span || span->pageAddr != ptr || span->numPages != numPages || span->isFree) return;
+
+    // 合并之后只要有一部分没有归还给操作系统，整个Span就按未归还处理
+    span->isZeroed = false;
+    coalesce(span);
+    span->isReleased = false;
+    insertFreeSpan(span);
+
+    if(releaseRate_ > 0) {
+        incrementalRelease();
+    }
+}
+
+size_t PageCache::releaseFreeMemory() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return releasePages(SIZE_MAX, std::chrono::steady_clock::time_point::max());
+}
+
+void PageCache::setReleaseRate(size_t bytesPerSecond, size_t idleMilliseconds) {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    releaseRate_ = bytesPerSecond;
+    releaseIdle_ = std::chrono::milliseconds(idleMilliseconds);
+    lastReleaseTime_ = std::chrono::steady_clock::now();
+}
+
+void PageCache::coalesce(Span* span) {
+    // 尝试合并左边相邻的Span：左边一页如果属于空闲Span，一定是这个空闲Span的尾页
+    Span* prevSpan = getSpan(static_cast<char*>(span->pageAddr) - PAGE_SIZE);
+    if(prevSpan && prevSpan->isFree) {
+        removeFreeSpan(prevSpan);
+        span->pageAddr = prevSpan->pageAddr;
+        span->numPages += prevSpan->numPages;
+        span->isZeroed = span->isZeroed && prevSpan->isZeroed;
+        // 页表中仍然指向prevSpan的页（它原来的尾页）在getSpan中按范围检查排除
+        prevSpan->numPages = 0;
+        spanAllocator_.deallocate(prevSpan);
+    }
+
+    // 尝试合并右边相邻的Span：右边一页如果属于空闲Span，一定是这个空闲Span的首页
+    Span* nextSpan = getSpan(static_cast<char*>(span->pageAddr) + span->numPages * PAGE_SIZE);
+    if(nextSpan && nextSpan->isFree) {
+        removeFreeSpan(nextSpan);
+        span->numPages += nextSpan->numPages;
+        span->isZeroed = span->isZeroed && nextSpan->isZeroed;
+        nextSpan->numPages = 0;
+        spanAllocator_.deallocate(nextSpan);
+    }
+}
+
+void PageCache::setHugePageMode(bool enable) {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    hugePageMode_ = enable;
+}
+
+void PageCache::incrementalRelease() {
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastReleaseTime_).count();
+
+    // 按照距离上一次归还的时间计算这一次可以归还的页数，不足一页时等下一次再累计
+    size_t maxPages = releaseRate_ * elapsed / 1000 / PAGE_SIZE;
+    if(maxPages == 0) return;
+
+    lastReleaseTime_ = now;
+    releasePages(maxPages, now - releaseIdle_);
+}
+
+size_t PageCache::releasePages(size_t maxPages, std::chrono::steady_clock::time_point idleBefore) {
+    size_t released = 0;
+
+    auto releaseList = [&](Span* list) {
+        for(Span* span = list->next; span != list && released < maxPages; span = span->next) {
+            if(span->isReleased || span->freeTime > idleBefore) continue;
+
+            // MADV_DONTNEED立即释放物理页，RSS马上下降；再次访问时由内核分配清零的新页
+            if(madvise(span->pageAddr, span->numPages * PAGE_SIZE, MADV_DONTNEED) != 0) continue;
+
+            span->isReleased = true;
+            span->isZeroed = true;
+            releasedPages_ += span->numPages;
+            released += span->numPages;
         }
-        // 如果找到了就进行合并，并把原来的nextAddr从addressToSpan_中删除，并delete nextSpan
-        if(found) {
-            span->numPages += nextSpan->numPages;
-            addressToSpan_.erase(nextAddr);
-            delete nextSpan;
+    };
+
+    // 优先归还大的Span
+    releaseList(&largeList_);
+    for(size_t n = MAX_PAGES - 1; n > 0 && released < maxPages; n --) {
+        releaseList(&freeLists_[n]);
+    }
+    return released;
+}
+
+void PageCache::insertFreeSpan(Span* span) {
+    span->isFree = true;
+    span->sizeClass = FREE_SPAN_CLASS;
+    span->freeTime = std::chrono::steady_clock::now();
+    freePages_ += span->numPages;
+    if(span->isReleased) {
+        releasedPages_ += span->numPages;
+    }
+
+    // 映射首尾两页，中间的页不会被用来查找相邻的Span
+    pageMap_.set(pageId(span->pageAddr), span);
+    pageMap_.set(pageId(span->pageAddr) + span->numPages - 1, span);
+
+    listPush(span->numPages < MAX_PAGES ? &freeLists_[span->numPages] : &largeList_, span);
+}
+
+void PageCache::removeFreeSpan(Span* span) {
+    listRemove(span);
+
+    span->isFree = false;
+    freePages_ -= span->numPages;
+    if(span->isReleased) {
+        releasedPages_ -= span->numPages;
+    }
+}
+
+PageCache::Span* PageCache::findFreeSpan(size_t numPages) {
+    for(size_t n = numPages; n < MAX_PAGES; n ++) {
+        if(!listEmpty(&freeLists_[n])) {
+            return freeLists_[n].next;
         }
     }
 
-    // 把归还的Span（可能和右边相邻的空闲Span进行了合并）插入到对应页数的链表中
-    auto& list = pageNumToSpan_[span->numPages];
-    span->next = list;
-    list = span;
+    // 大Span链表中选择页数最接近numPages的（best fit），页数相同时选择地址较低的
+    Span* best = nullptr;
+    for(Span* span = largeList_.next; span != &largeList_; span = span->next) {
+        if(span->numPages < numPages) continue;
+        if(!best || span->numPages < best->numPages 
+            || (span->numPages == best->numPages && span->pageAddr < best->pageAddr)) {
+            best = span;
+        }
+    }
+    return best;
+}
+
+size_t PageCache::getSystemAllocCount() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return systemAllocCount_;
+}
+
+size_t PageCache::getFreePages() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return freePages_;
+}
+
+size_t PageCache::getMetadataBytes() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return spanAllocator_.chunkBytes();
+}
+
+size_t PageCache::getHugetlbAllocCount() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return hugetlbAllocCount_;
+}
+
+size_t PageCache::getLostPages() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return lostPages_;
+}
+
+size_t PageCache::getReleasedPages() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+    return releasedPages_;
+}
+
+size_t PageCache::getLargestFreeSpan() {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    size_t largest = 0;
+    for(Span* span = largeList_.next; span != &largeList_; span = span->next) {
+        largest = std::max(largest, span->numPages);
+    }
+    for(size_t n = MAX_PAGES - 1; n > largest && n > 0; n --) {
+        if(!listEmpty(&freeLists_[n])) {
+            largest = n;
+            break;
+        }
+    }
+    return largest;
+}
+
+void PageCache::registerSpan(Span* span) {
+    size_t firstPage = pageId(span->pageAddr);
+    for(size_t i = 0; i < span->numPages; i ++) {
+        pageMap_.set(firstPage + i, span);
+    }
+}
+
+// 申请size + 2MB的内存，截掉首尾多余的部分，得到2MB对齐的size大小的区域
+static void* mapAligned(size_t size, int prot, int flags) {
+    const size_t align = PageCache::HUGE_PAGE_SIZE;
+    void* raw = mmap(nullptr, size + align, prot, flags, -1, 0);
+    if(raw == MAP_FAILED) return nullptr;
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + align - 1) & ~(uintptr_t(align) - 1);
+    if(aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    if(size_t tail = start + size + align - (aligned + size)) {
+        munmap(reinterpret_cast<void*>(aligned + size), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+void PageCache::reserveAddressSpace() {
+    // PROT_NONE + MAP_NORESERVE只占用虚拟地址，不计入内存提交量，也不产生物理页
+    void* ptr = mapAligned(RESERVE_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+    if(!ptr) return;
+
+    reserveStart_ = static_cast<char*>(ptr);
+    reserveEnd_ = reserveStart_ + RESERVE_BYTES;
+    bumpPtr_ = reserveStart_;
+    commitEnd_ = reserveStart_;
+    systemAllocCount_ ++;
+}
+
+bool PageCache::growSpan(Span* span, size_t newPages) {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    if(newPages <= span->numPages) return true;
+    size_t needed = newPages - span->numPages;
+    char* end = static_cast<char*>(span->pageAddr) + span->numPages * PAGE_SIZE;
+
+    // Span正好位于已切分部分的末尾：从预留范围中继续切分，新的区域作为空闲Span和右边相邻
+    // 大页模式下新区域可能不连续（hugetlbfs或者2MB对齐），不尝试
+    Span* next = getSpan(end);
+    if(!next && end == bumpPtr_ && !hugePageMode_) {
+        if(!growHeap(needed)) return false;
+        next = getSpan(end);
+    }
+    if(!next || !next->isFree || next->numPages < needed) return false;
+
+    // 从右边的空闲Span中取出needed页，剩下的部分重新插入空闲链表
+    removeFreeSpan(next);
+    if(next->numPages > needed) {
+        next->pageAddr = end + needed * PAGE_SIZE;
+        next->numPages -= needed;
+        insertFreeSpan(next);
+    }else {
+        spanAllocator_.deallocate(next);
+    }
+
+    span->numPages = newPages;
+    registerSpan(span);
+    return true;
+}
+
+void* PageCache::splitSpan(void* ptr, size_t numPages) {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    Span* span = getSpan(ptr);
+    if(!span || span->pageAddr != ptr || span->isFree || numPages == 0 || numPages >= span->numPages) return nullptr;
+
+    Span* tail = spanAllocator_.allocate();
+    if(!tail) return nullptr;
+
+    tail->pageAddr = static_cast<char*>(span->pageAddr) + numPages * PAGE_SIZE;
+    tail->numPages = span->numPages - numPages;
+    tail->sizeClass = span->sizeClass;
+    tail->isZeroed = span->isZeroed;
+    span->numPages = numPages;
+    // 原Span的页映射不变，只需要把后半部分的页改为映射到新Span
+    registerSpan(tail);
+    return tail->pageAddr;
+}
+
+PageCache::MoveResult PageCache::movePages(void* from, void* to, size_t numPages) {
+    size_t size = numPages * PAGE_SIZE;
+    auto reserved = [&](void* ptr) {
+        return ptr >= reserveStart_ && static_cast<char*>(ptr) + size <= reserveEnd_;
+    };
+    // 预留范围外可能是hugetlbfs大页，不能在其中留下普通页的映射
+    if(!reserveStart_ || !reserved(from) || !reserved(to)) return MoveResult::Failed;
+    if(remapCount_.fetch_add(1, std::memory_order_relaxed) >= MAX_REMAPS) return MoveResult::Failed;
+
+    // 跨越了多个映射（例如大页模式下madvise拆开的区域）时mremap失败，什么都不会改变
+    if(mremap(from, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, to) == MAP_FAILED) return MoveResult::Failed;
+
+    // from处的映射已经被移走，重新映射为可读写的匿名页，预留范围保持连续可用
+    // 映射数量（vm.max_map_count）或者系统内存耗尽时会失败，此时from处是空洞，访问会触发段错误
+    if(mmap(from, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        return MoveResult::Unmapped;
+    }
+    return MoveResult::Moved;
+}
+
+void PageCache::discardSpan(Span* span) {
+    std::lock_guard<AdaptiveLock> lock(mutex_);
+
+    size_t firstPage = pageId(span->pageAddr);
+    for(size_t i = 0; i < span->numPages; i ++) {
+        pageMap_.set(firstPage + i, nullptr);
+    }
+    lostPages_ += span->numPages;
+    span->numPages = 0;
+    spanAllocator_.deallocate(span);
+}
+
+bool PageCache::growHeap(size_t numPages) {
+    // 大页模式下申请2MB整数倍的区域，多余的页作为空闲Span留给之后的申请
+    if(hugePageMode_) {
+        numPages = (numPages + HUGE_PAGE_PAGES - 1) / HUGE_PAGE_PAGES * HUGE_PAGE_PAGES;
+    }
+
+    void* ptr = systemAllocate(numPages);
+    if(!ptr) return false;
+    return addFreeRegion(ptr, numPages);
+}
+
+bool PageCache::addFreeRegion(void* ptr, size_t numPages) {
+    Span* span = spanAllocator_.allocate();
+    // Span元数据申请失败时这段内存就丢失了，只会在系统内存耗尽时发生
+    if(!span) return false;
+
+    span->pageAddr = ptr;
+    span->numPages = numPages;
+    // 新申请的匿名内存已经由内核清零
+    span->isZeroed = true;
+    // 预留范围中相邻的区域是连续的，可以和上一次切分剩下的空闲Span合并
+    coalesce(span);
+    span->isReleased = false;
+    insertFreeSpan(span);
+    return true;
 }
 
 void* PageCache::systemAllocate(size_t numPages) {
     size_t size = numPages * PAGE_SIZE;
-    
-    // 使用mmap进行系统大块内存申请更高效
-    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if(ptr == MAP_FAILED) return nullptr;
 
-    memset(ptr, 0, size);
+#ifdef MAP_HUGETLB
+    // hugetlbfs大页：需要系统预留了大页（/proc/sys/vm/nr_hugepages），没有时mmap直接失败，之后不再尝试
+    // 不能用MAP_FIXED映射到预留范围中，失败时原来的映射可能已经被拆掉，所以单独mmap
+    if(hugePageMode_ && hugetlbAvailable_) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(ptr != MAP_FAILED) {
+            if(!pageMap_.ensure(pageId(ptr), numPages)) {
+                munmap(ptr, size);
+                return nullptr;
+            }
+            systemAllocCount_ ++;
+            hugetlbAllocCount_ ++;
+            return ptr;
+        }
+        hugetlbAvailable_ = false;
+    }
+#endif
+
+    if(reserveStart_) {
+        // 大页模式下区域起点按2MB对齐，跳过的页作为空闲Span
+        char* start = bumpPtr_;
+        if(hugePageMode_) {
+            start = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(bumpPtr_) + HUGE_PAGE_SIZE - 1) 
+                & ~(uintptr_t(HUGE_PAGE_SIZE) - 1));
+        }
+
+        if(start + size <= reserveEnd_) {
+            char* end = start + size;
+            // 新内存的页表叶子节点在这里分配好，之后从这块内存切分出来的Span都不需要再分配
+            if(!pageMap_.ensure(pageId(bumpPtr_), (end - bumpPtr_) / PAGE_SIZE)) return nullptr;
+
+            // 按COMMIT_BYTES的粒度把预留的地址设置为可读写，mprotect之后相邻的映射会合并成一个VMA
+            if(end > commitEnd_) {
+                char* newCommitEnd = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(end) + COMMIT_BYTES - 1) 
+                    & ~(uintptr_t(COMMIT_BYTES) - 1));
+                newCommitEnd = std::min(newCommitEnd, reserveEnd_);
+                if(mprotect(commitEnd_, newCommitEnd - commitEnd_, PROT_READ | PROT_WRITE) != 0) return nullptr;
+                commitEnd_ = newCommitEnd;
+                systemAllocCount_ ++;
+            }
+
+            char* skipped = bumpPtr_;
+            bumpPtr_ = end;
+            if(start > skipped) {
+                addFreeRegion(skipped, (start - skipped) / PAGE_SIZE);
+            }
+            if(hugePageMode_) {
+                adviseHugePages(start, size);
+            }
+            // 匿名内存已经清零，不需要再memset（否则会提前触发所有页的缺页）
+            return start;
+        }
+    }
+
+    // 预留范围用完（或者预留失败）时直接mmap
+    void* ptr = hugePageMode_ ? mapAligned(size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS)
+        : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED || !ptr) return nullptr;
+    systemAllocCount_ ++;
+
+    if(!pageMap_.ensure(pageId(ptr), numPages)) {
+        munmap(ptr, size);
+        return nullptr;
+    }
+    if(hugePageMode_) {
+        adviseHugePages(ptr, size);
+    }
     return ptr;
 }
 
+void PageCache::adviseHugePages(void* ptr, size_t size) {
+    // 透明大页：提示内核在缺页时直接分配2MB的大页
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
 } // namespace myMemoryPool
\ No newline at end of file
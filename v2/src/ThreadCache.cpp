@@ -1,10 +1,77 @@
 #include "../include/ThreadCache.h"
 #include "../include/CentralCache.h"
-#include <cstdlib>
+#include "../include/PageCache.h"
+#include "../include/LargeCache.h"
+#include "../include/CpuCache.h"
+#include "../include/MetadataAllocator.h"
+#include <cstring>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace myMemoryPool {
 
-const size_t threshold = 64;
+// 达到一个批次之后，链表长度超过上限的次数超过MAX_OVERAGES时缩小上限
+static const size_t MAX_OVERAGES = 3;
+
+// 线程退出时析构，把本线程ThreadCache中的内存块归还给CentralCache
+// ThreadCache本身保持平凡析构，只有真正缓存过内存块的线程才会构造这个对象，分配的快速路径不受影响
+struct ThreadCacheCleaner {
+    ~ThreadCacheCleaner() {
+        ThreadCache::getInstance()->destroy();
+    }
+};
+
+// 查询不到最后一级cache的大小时使用的默认值
+static const size_t DEFAULT_NON_TEMPORAL_BYTES = 32 * 1024 * 1024;
+
+// 超过最后一级cache大小的内存块清零时使用non-temporal store：清零的数据本来就放不进cache，不必挤掉cache中的热数据
+// 更小的内存块写完还留在cache中，调用者紧接着访问时直接命中，memset更快
+static size_t nonTemporalBytes() {
+    static const size_t bytes = []() {
+        long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if(llc <= 0) llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return llc > 0 ? static_cast<size_t>(llc) : DEFAULT_NON_TEMPORAL_BYTES;
+    }();
+    return bytes;
+}
+
+// 大内存块清零：使用non-temporal store直接写内存，不把整块内存读入cache，也不挤掉cache中的热数据
+// ptr按页对齐（大对象由Span提供）
+static void zeroLarge(void* ptr, size_t size) {
+#ifdef __SSE2__
+    if(size < nonTemporalBytes()) {
+        memset(ptr, 0, size);
+        return;
+    }
+
+    __m128i zero = _mm_setzero_si128();
+    char* p = static_cast<char*>(ptr);
+    size_t streamBytes = size & ~size_t(63);
+    for(size_t offset = 0; offset < streamBytes; offset += 64) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(p + offset), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(p + offset + 16), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(p + offset + 32), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(p + offset + 48), zero);
+    }
+    _mm_sfence();
+    memset(p + streamBytes, 0, size - streamBytes);
+#else
+    memset(ptr, 0, size);
+#endif
+}
+
+std::mutex ThreadCache::registryMutex_;
+ThreadCache* ThreadCache::registryHead_ = nullptr;
+size_t ThreadCache::budget_ = ThreadCache::DEFAULT_BUDGET;
+ptrdiff_t ThreadCache::unclaimedBudget_ = ThreadCache::DEFAULT_BUDGET;
+ThreadCache* ThreadCache::stealCursor_ = nullptr;
+RemoteFreeQueue* ThreadCache::freeQueues_ = nullptr;
+std::atomic<bool> ThreadCache::remoteFree_{false};
+
+// 远程释放队列的分配器，由registryMutex_保护
+static MetadataAllocator<RemoteFreeQueue> queueAllocator;
 
 void* ThreadCache::allocate(size_t size) {
     // size为0补到对齐值
@@ -12,88 +79,620 @@ void* ThreadCache::allocate(size_t size) {
         size = ALIGNMENT;
     }
 
-    // size超过最大分配内存256KB，使用系统malloc
+    // size超过最大分配内存256KB，由PageCache的Span提供
     if(size > MAX_BYTES) {
-        return malloc(size);
+        return LargeCache::getInstance().allocate(size);
     }
 
     // 计算size对齐之后映射到的index
-    size_t index = SizeClass::getIndex(size);
+    return allocateIndex(SizeClass::getIndex(size));
+}
+
+void* ThreadCache::allocateIndex(size_t index, bool* zeroed) {
+    // per-CPU模式下小对象由当前CPU的缓存分配
+    if(CpuCache::enabled()) {
+        return CpuCache::getInstance().allocate(index);
+    }
+
+    allocCount_++;
+    // 小对象先从弹匣中取
+    if(index < MAGAZINE_CLASSES) {
+        Magazine& mag = magazines_[index];
+        if(mag.count) {
+            subCachedBytes(SizeClass::classSize(index));
+            return mag.slots[--mag.count];
+        }
+    }
 
-    // 对应链表长度减一，即使可能为空一开始，但是后面的fetchFromCentralCache会增加链表长度
-    freeListSize_[index]--;
+    FreeList& list = freeList_[index];
     // 由于ptr有可能为nullptr，所以要用if
-    if(void* ptr = freeList_[index]) {
-        freeList_[index] = *reinterpret_cast<void**>(ptr);
+    if(void* ptr = list.head) {
+        list.head = *reinterpret_cast<void**>(ptr);
+        list.size--;
+        subCachedBytes(SizeClass::classSize(index));
         return ptr;
     }
 
-    return fetchFromCentralCache(index);
+    return fetchFromCentralCache(index, zeroed);
+}
+
+void* ThreadCache::allocateZeroed(size_t size) {
+    if(size == 0) {
+        size = ALIGNMENT;
+    }
+
+    if(size > MAX_BYTES) {
+        void* ptr = LargeCache::getInstance().allocate(size);
+        if(!ptr) return nullptr;
+        // 刚从系统申请或者已经归还过操作系统的Span中的页一定是0，直接跳过清零
+        if(!PageCache::getInstance().getSpan(ptr)->isZeroed) {
+            zeroLarge(ptr, size);
+        }else {
+            zeroSkipCount_++;
+        }
+        return ptr;
+    }
+
+    // 小对象只有本地缓存未命中、并且刚从清零的Span中切分出来时才知道一定为0，其他情况（复用的内存块）清零
+    bool zeroed = false;
+    void* ptr = allocateIndex(SizeClass::getIndex(size), &zeroed);
+    if(!ptr) return nullptr;
+    if(zeroed) {
+        zeroSkipCount_++;
+    }else {
+        memset(ptr, 0, size);
+    }
+    return ptr;
 }
 
 void ThreadCache::release(void* ptr, size_t size) {
     if(size > MAX_BYTES) {
-        free(ptr);
+        PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+        if(span && !span->isFree) {
+            LargeCache::getInstance().release(span);
+        }
         return;
     }
 
-    size_t index = SizeClass::getIndex(size);
+    releaseIndex(ptr, SizeClass::getIndex(size));
+}
 
-    *reinterpret_cast<void**>(ptr) = freeList_[index];
-    freeList_[index] = ptr;
-    freeListSize_[index]++;
+void* ThreadCache::reallocate(void* ptr, size_t oldSize, size_t newSize) {
+    if(!ptr) return allocate(newSize);
+    if(newSize == 0) {
+        release(ptr, oldSize);
+        return nullptr;
+    }
+
+    if(oldSize <= MAX_BYTES) {
+        // 新的大小仍然对应原来的size class，内存块已经足够
+        if(newSize <= MAX_BYTES && SizeClass::getIndex(newSize) == SizeClass::getIndex(oldSize)) return ptr;
+    }else if(newSize > MAX_BYTES) {
+        PageCache& pageCache = PageCache::getInstance();
+        PageCache::Span* span = pageCache.getSpan(ptr);
+        if(!span) return nullptr;
+
+        size_t oldPages = span->numPages;
+        size_t newPages = LargeCache::roundUpPages((newSize + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE);
+        // 缩小到一半以上时不移动，多余的页随Span一起释放
+        if(newPages <= oldPages) {
+            if(newPages * 2 >= oldPages) return ptr;
+        }else {
+            // 增长时优先原地并入右边相邻的空闲页
+            if(pageCache.growSpan(span, newPages)) return ptr;
+
+            // 大缓冲区把物理页整体移动到新的Span，原来的页变成清零的页随Span释放
+            if(oldPages * PageCache::PAGE_SIZE >= MREMAP_BYTES) {
+                void* newPtr = LargeCache::getInstance().allocate(newSize);
+                if(!newPtr) return nullptr;
+                PageCache::MoveResult result = pageCache.movePages(ptr, newPtr, oldPages);
+                if(result == PageCache::MoveResult::Failed) {
+                    memcpy(newPtr, ptr, oldSize);
+                }
+                // 原来的页没能重新映射时不能再交给其他人，从页表中去掉并计入丢弃的页数
+                if(result == PageCache::MoveResult::Unmapped) {
+                    pageCache.discardSpan(span);
+                }else {
+                    LargeCache::getInstance().release(span);
+                }
+                return newPtr;
+            }
+        }
+    }
 
-    // 链表长度超过阈值，向CentralCache归还部分内存
-    if(freeListSize_[index] >= threshold) {
-        returnToCentralCache(freeList_[index], size);
-    }    
+    void* newPtr = allocate(newSize);
+    if(!newPtr) return nullptr;
+    memcpy(newPtr, ptr, std::min(oldSize, newSize));
+    release(ptr, oldSize);
+    return newPtr;
+}
+
+size_t ThreadCache::usableSize(const void* ptr) {
+    if(!ptr) return 0;
+    PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+    if(!span || span->isFree) return 0;
+
+    if(span->sizeClass < FREE_LIST_SIZE) {
+        return SizeClass::classSize(span->sizeClass);
+    }
+    return span->numPages * PageCache::PAGE_SIZE - (static_cast<const char*>(ptr) - static_cast<const char*>(span->pageAddr));
 }
 
-void* ThreadCache::fetchFromCentralCache(size_t index) {
-    void* start = CentralCache::getInstance().fetchMemory(index);
+void ThreadCache::releaseIndex(void* ptr, size_t index) {
+    // 远程释放模式下需要查出内存块所在的Span才能知道所属的线程
+    if(remoteFreeEnabled()) {
+        PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+        if(span && releaseRemote(ptr, span->owner.load(std::memory_order_relaxed), index)) return;
+    }
+
+    releaseToList(ptr, index);
+}
+
+void* ThreadCache::allocateAligned(size_t size, size_t alignment) {
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0) return nullptr;
+    if(size == 0) {
+        size = ALIGNMENT;
+    }
+
+    // 小于页大小的对齐由内存块大小合适的size class提供
+    if(alignment < PageCache::PAGE_SIZE) {
+        size_t index = SizeClass::getAlignedIndex(size, alignment);
+        if(index < FREE_LIST_SIZE) {
+            return allocateIndex(index);
+        }
+        if(size > MAX_BYTES) {
+            return LargeCache::getInstance().allocate(size);
+        }
+    }
+
+    // 按页（或者更大的粒度）对齐：直接由PageCache分配对齐的Span，释放时和大对象一样交给LargeCache
+    // 大于MAX_BYTES的部分按LargeCache的档位取整，之后可以被相同档位的大对象复用
+    size_t numPages = (size + PageCache::PAGE_SIZE - 1) / PageCache::PAGE_SIZE;
+    if(size > MAX_BYTES) {
+        numPages = LargeCache::roundUpPages(numPages);
+    }
+    size_t alignPages = std::max<size_t>(1, alignment / PageCache::PAGE_SIZE);
+    return PageCache::getInstance().allocateSpan(numPages, LARGE_SIZE_CLASS, alignPages);
+}
+
+void ThreadCache::releaseAligned(void* ptr, size_t size, size_t alignment) {
+    if(!ptr) return;
+    if(size == 0) {
+        size = ALIGNMENT;
+    }
+
+    if(alignment < PageCache::PAGE_SIZE) {
+        size_t index = SizeClass::getAlignedIndex(size, alignment);
+        if(index < FREE_LIST_SIZE) {
+            releaseIndex(ptr, index);
+            return;
+        }
+    }
+
+    // 大对象和按页对齐的对象都是独占一个Span
+    PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+    if(span && !span->isFree) {
+        LargeCache::getInstance().release(span);
+    }
+}
+
+void ThreadCache::release(void* ptr) {
+    if(!ptr) return;
+
+    // 页表中查不到（或者所在的Span已经空闲）说明不是内存池分配出去的内存，直接忽略
+    PageCache::Span* span = PageCache::getInstance().getSpan(ptr);
+    if(!span || span->isFree) return;
+
+    if(span->sizeClass == LARGE_SIZE_CLASS) {
+        LargeCache::getInstance().release(span);
+        return;
+    }
+
+    if(remoteFreeEnabled() && releaseRemote(ptr, span->owner.load(std::memory_order_relaxed), span->sizeClass)) return;
+
+    releaseToList(ptr, span->sizeClass);
+}
+
+bool ThreadCache::releaseRemote(void* ptr, RemoteFreeQueue* owner, size_t index) {
+    if(!owner || owner == remote_ || CpuCache::enabled()) return false;
+
+    // 所属线程已经退出：内存块留在本线程，顺便把退出时刚好压入队列、没有被取走的内存块交给CentralCache
+    if(owner->orphaned.load(std::memory_order_acquire)) {
+        if(void* stray = owner->takeAll(index)) {
+            CentralCache::getInstance().returnMemory(stray, index);
+        }
+        return false;
+    }
+
+    owner->push(index, ptr);
+    remoteFreeCount_++;
+    return true;
+}
+
+void* ThreadCache::drainRemote(size_t index) {
+    void* start = remote_ ? remote_->takeAll(index) : nullptr;
     if(!start) return nullptr;
 
+    // 第一个内存块返回给调用者，剩下的整条链表接到线程本地链表头部（未命中时本地链表为空）
+    FreeList& list = freeList_[index];
     void* result = start;
-    freeList_[index] = *reinterpret_cast<void**>(start);
+    start = *reinterpret_cast<void**>(start);
+    size_t count = 1;
+    if(start) {
+        void* end = start;
+        count ++;
+        while(*reinterpret_cast<void**>(end)) {
+            end = *reinterpret_cast<void**>(end);
+            count ++;
+        }
+        *reinterpret_cast<void**>(end) = list.head;
+        list.head = start;
+    }
+    list.size += count - 1;
+    addCachedBytes((count - 1) * SizeClass::classSize(index));
+    remoteDrainCount_ += count;
 
-    size_t batchNum = 0;
-    void* cur = start;
+    if(cachedBytes() > maxBytes()) {
+        scavenge();
+    }
+    return result;
+}
 
-    // 当前的fetchMemory设计的是只返回一个内存块，因此batchNum应该为1
-    while(cur != nullptr) {
-        batchNum ++;
-        cur = *reinterpret_cast<void**>(cur);
+void ThreadCache::releaseToList(void* ptr, size_t index) {
+    if(CpuCache::enabled()) {
+        CpuCache::getInstance().release(ptr, index);
+        return;
     }
 
-    freeListSize_[index] += batchNum;
+    // 只释放、从未分配过的线程也要在退出时归还缓存的内存块
+    if(!registered_) {
+        registerThread();
+    }
 
-    return result;
+    addCachedBytes(SizeClass::classSize(index));
+
+    // 小对象先放入弹匣，弹匣满了再挂到链表
+    if(index < MAGAZINE_CLASSES) {
+        Magazine& mag = magazines_[index];
+        if(mag.count < MAGAZINE_SIZE) {
+            mag.slots[mag.count++] = ptr;
+            if(cachedBytes() > maxBytes()) {
+                scavenge();
+            }
+            return;
+        }
+    }
+
+    FreeList& list = freeList_[index];
+    *reinterpret_cast<void**>(ptr) = list.head;
+    list.head = ptr;
+    list.size++;
+
+    // 链表长度超过上限，或者本线程缓存的总字节数超过上限，向CentralCache归还部分内存
+    if(list.size > list.maxLength) {
+        listTooLong(index);
+    }else if(cachedBytes() > maxBytes()) {
+        scavenge();
+    }
+}
+
+void* ThreadCache::fetchFromCentralCache(size_t index, bool* zeroed) {
+    if(!registered_) {
+        registerThread();
+    }
+    missCount_++;
+
+    // 其他线程窃取预算时本线程的上限已经用满，缩小缓存让出一部分
+    if(trimRequested_.load(std::memory_order_relaxed)) {
+        trimRequested_.store(false, std::memory_order_relaxed);
+        shrink();
+    }
+
+    // 先取回其他线程归还到本线程的内存块
+    if(void* ptr = drainRemote(index)) {
+        return ptr;
+    }
+
+    FreeList& list = freeList_[index];
+    size_t size = SizeClass::classSize(index);
+
+    // 慢启动：同一个size class连续未命中时，链表长度上限逐渐增大，不足一个批次时每次加一，之后每次加一个批次
+    size_t limit = SizeClass::numMoveSize(size);
+    if(list.maxLength < limit) {
+        list.maxLength++;
+    }else {
+        size_t newLength = std::min(list.maxLength + limit, MAX_LIST_LENGTH);
+        list.maxLength = newLength - newLength % limit;
+    }
+    size_t batchNum = std::min<size_t>(list.maxLength, limit);
+
+    // 调用者需要知道返回的内存块是否为0时（allocateZeroed）才记录
+    uint32_t zeroedMask = 0;
+    uint32_t* mask = zeroed ? &zeroedMask : nullptr;
+
+    // 小对象的批次直接写入弹匣（未命中时弹匣为空），最后一个返回给调用者
+    if(index < MAGAZINE_CLASSES) {
+        Magazine& mag = magazines_[index];
+        size_t actualNum = CentralCache::getInstance().fetchRange(mag.slots, batchNum, index, remote_, mask);
+        if(actualNum == 0) return nullptr;
+        if(zeroed) {
+            *zeroed = (zeroedMask >> (actualNum - 1)) & 1;
+        }
+
+        mag.count = actualNum - 1;
+        addCachedBytes((actualNum - 1) * size);
+        if(cachedBytes() > maxBytes()) {
+            scavenge();
+        }
+        return mag.slots[actualNum - 1];
+    }
+
+    void* batch[MAX_BATCH_NUM];
+    size_t actualNum = CentralCache::getInstance().fetchRange(batch, batchNum, index, remote_, mask);
+    if(actualNum == 0) return nullptr;
+    if(zeroed) {
+        *zeroed = zeroedMask & 1;
+    }
+
+    // 第一个内存块返回给调用者（不会写入next指针），剩下的挂到线程本地链表（未命中时本地链表为空）
+    for(size_t i = actualNum - 1; i > 0; i --) {
+        *reinterpret_cast<void**>(batch[i]) = list.head;
+        list.head = batch[i];
+    }
+    list.size += actualNum - 1;
+    addCachedBytes((actualNum - 1) * size);
+
+    if(cachedBytes() > maxBytes()) {
+        scavenge();
+    }
+    return batch[0];
+}
+
+void ThreadCache::returnMagazine(size_t index, size_t num) {
+    Magazine& mag = magazines_[index];
+    num = std::min<size_t>(num, mag.count);
+    mag.count -= num;
+    subCachedBytes(num * SizeClass::classSize(index));
+    CentralCache::getInstance().returnMemory(mag.slots + mag.count, num, index);
+}
+
+void ThreadCache::returnToCentralCache(size_t index, size_t num) {
+    FreeList& list = freeList_[index];
+    num = std::min<size_t>(num, list.size);
+    list.size -= num;
+    subCachedBytes(num * SizeClass::classSize(index));
+
+    // 从链表头部按批次取下内存块，以指针数组的形式归还
+    void* batch[MAX_BATCH_NUM];
+    while(num > 0) {
+        size_t n = std::min(num, MAX_BATCH_NUM);
+        for(size_t i = 0; i < n; i ++) {
+            batch[i] = list.head;
+            list.head = *reinterpret_cast<void**>(list.head);
+        }
+        CentralCache::getInstance().returnMemory(batch, n, index);
+        num -= n;
+    }
+}
+
+void ThreadCache::returnMagazineBottom(size_t index, size_t num) {
+    Magazine& mag = magazines_[index];
+    num = std::min<size_t>(num, mag.count);
+    if(num == 0) return;
+    subCachedBytes(num * SizeClass::classSize(index));
+    CentralCache::getInstance().returnMemory(mag.slots, num, index);
+    // 剩下的内存块移到弹匣底部，保持原来的顺序
+    std::copy(mag.slots + num, mag.slots + mag.count, mag.slots);
+    mag.count -= num;
+}
+
+void ThreadCache::returnListTail(size_t index, size_t num) {
+    FreeList& list = freeList_[index];
+    num = std::min<size_t>(num, list.size);
+    if(num == 0) return;
+
+    // 保留链表前面的keep个内存块，从第keep个之后断开
+    size_t keep = list.size - num;
+    void* tail = list.head;
+    if(keep == 0) {
+        list.head = nullptr;
+    }else {
+        void* last = list.head;
+        for(size_t i = 1; i < keep; i ++) {
+            last = *reinterpret_cast<void**>(last);
+        }
+        tail = *reinterpret_cast<void**>(last);
+        *reinterpret_cast<void**>(last) = nullptr;
+    }
+    list.size -= num;
+    subCachedBytes(num * SizeClass::classSize(index));
+    CentralCache::getInstance().returnMemory(tail, index);
 }
 
-void ThreadCache::returnToCentralCache(void* start, size_t size) {
-    size_t index = SizeClass::getIndex(size);
+void ThreadCache::listTooLong(size_t index) {
+    FreeList& list = freeList_[index];
+    size_t limit = SizeClass::numMoveSize(SizeClass::classSize(index));
+    returnToCentralCache(index, limit);
+
+    // 只释放不分配的size class上限也会逐渐增大到一个批次，之后每次归还整个批次
+    // 达到一个批次之后频繁超过上限，说明释放多于分配，缩小上限
+    if(list.maxLength < limit) {
+        list.maxLength++;
+    }else if(list.maxLength > limit) {
+        if(++list.overages > MAX_OVERAGES) {
+            list.maxLength -= limit;
+            list.overages = 0;
+        }
+    }
+}
+
+void ThreadCache::scavenge() {
+    shrink();
+    // 本线程缓存的需求较大，尝试增大上限，下一次少归还一些
+    // 释放路径上每次超过上限都会走到这里，失败之后退避一段时间，不反复争用注册表的锁
+    if(stealBackoff_ > 0) {
+        stealBackoff_--;
+    }else if(!increaseCacheLimit()) {
+        stealBackoff_ = STEAL_BACKOFF;
+    }
+}
+
+void ThreadCache::shrink() {
+    // 每个弹匣和链表归还最早放入的一半（弹匣底部和链表尾部），最近释放、大概率还在CPU cache中的一半留在本线程
+    // 上限超过一个批次的缩小一个批次
+    for(size_t index = 0; index < MAGAZINE_CLASSES; index ++) {
+        returnMagazineBottom(index, (magazines_[index].count + 1) / 2);
+    }
+    for(size_t index = 0; index < FREE_LIST_SIZE; index ++) {
+        FreeList& list = freeList_[index];
+        if(list.size == 0) continue;
+
+        returnListTail(index, (list.size + 1) / 2);
+        size_t limit = SizeClass::numMoveSize(SizeClass::classSize(index));
+        if(list.maxLength > limit) {
+            list.maxLength = std::max(list.maxLength - limit, limit);
+        }
+    }
+}
+
+bool ThreadCache::increaseCacheLimit() {
+    // 在释放路径上调用，锁被其他线程占用时直接放弃，不等待
+    std::unique_lock<std::mutex> lock(registryMutex_, std::try_to_lock);
+    if(!lock.owns_lock()) return false;
+    // 线程已经清理过（不在注册表中），不再占用预算
+    if(!prevThread_ && registryHead_ != this) return false;
+
+    if(unclaimedBudget_ >= static_cast<ptrdiff_t>(STEAL_BYTES)) {
+        unclaimedBudget_ -= STEAL_BYTES;
+        maxBytes_.store(maxBytes() + STEAL_BYTES, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 没有未分配的预算，轮流从其他线程的上限中窃取，最多尝试10个线程
+    // 只窃取上限中没有用到的部分：其他线程（可能一直空闲）不会因此缓存超过自己的上限，预算才真正限制了内存
+    for(int i = 0; i < 10; i ++) {
+        if(!stealCursor_) {
+            stealCursor_ = registryHead_;
+        }
+        ThreadCache* victim = stealCursor_;
+        stealCursor_ = victim->nextThread_;
+        if(victim == this) continue;
+
+        size_t victimBytes = victim->maxBytes();
+        if(victimBytes < MIN_THREAD_BYTES + STEAL_BYTES) continue;
+        if(victim->cachedBytes() + STEAL_BYTES > victimBytes) {
+            // 上限已经用满，请求对方下一次未命中时缩小缓存
+            victim->trimRequested_.store(true, std::memory_order_relaxed);
+            continue;
+        }
+
+        victim->maxBytes_.store(victimBytes - STEAL_BYTES, std::memory_order_relaxed);
+        if(unclaimedBudget_ < 0) {
+            // 预算已经超支（预算被调小或者线程很多），窃取到的部分先偿还超支
+            unclaimedBudget_ += STEAL_BYTES;
+        }else {
+            maxBytes_.store(maxBytes() + STEAL_BYTES, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    return false;
+}
 
-    size_t batchNum = freeListSize_[index];
-    
-    // 保留一部分内存，剩下的返回给给CentralCache
-    size_t keepNum = batchNum / 4;
-    // size_t returnNum = batchNum - keepNum;
+void ThreadCache::registerThread() {
+    // 第一次经过时构造，线程退出时自动析构
+    static thread_local ThreadCacheCleaner cleaner;
+    (void)cleaner;
 
-    void* cur = start;
-    for(size_t i = 0; i < keepNum - 1; i ++) {
-        cur = *reinterpret_cast<void**>(cur);
+    std::lock_guard<std::mutex> lock(registryMutex_);
+    // 每个线程先分到MIN_THREAD_BYTES的预算，线程很多时未分配的预算可以为负，之后靠窃取在线程之间平衡
+    maxBytes_.store(MIN_THREAD_BYTES, std::memory_order_relaxed);
+    unclaimedBudget_ -= MIN_THREAD_BYTES;
+    // 优先复用退出的线程留下的远程释放队列，其中残留的内存块由本线程取走
+    if(freeQueues_) {
+        remote_ = freeQueues_;
+        freeQueues_ = remote_->nextFree;
+        remote_->orphaned.store(false, std::memory_order_relaxed);
+    }else {
+        remote_ = queueAllocator.allocate();
     }
+    nextThread_ = registryHead_;
+    prevThread_ = nullptr;
+    if(registryHead_) {
+        registryHead_->prevThread_ = this;
+    }
+    registryHead_ = this;
+    registered_ = true;
+}
 
-    if(cur != nullptr) {
-        void* next = *reinterpret_cast<void**>(cur);
-        *reinterpret_cast<void**>(cur) = nullptr;
+void ThreadCache::destroy() {
+    CentralCache& centralCache = CentralCache::getInstance();
 
-        freeList_[index] = start;
-        freeListSize_[index] = keepNum;
+    // 先标记队列，之后的远程释放都留在释放的线程中，下面取走队列时不会再有内存块源源不断地压入
+    if(remote_) {
+        remote_->orphaned.store(true, std::memory_order_seq_cst);
+    }
+    for(size_t index = 0; index < MAGAZINE_CLASSES; index ++) {
+        returnMagazine(index, MAGAZINE_SIZE);
+    }
+    for(size_t index = 0; index < FREE_LIST_SIZE; index ++) {
+        FreeList& list = freeList_[index];
+        // 按批次转换成指针数组归还，每次只占用一次CentralCache的锁
+        centralCache.returnMemory(list.head, index);
+        list.head = nullptr;
+        list.size = 0;
+        list.maxLength = 0;
+        list.overages = 0;
 
-        CentralCache::getInstance().returnMemory(next, index);
+        // 其他线程归还到本线程的内存块也交给CentralCache
+        if(remote_) {
+            centralCache.returnMemory(remote_->takeAll(index), index);
+        }
     }
+    cachedBytes_.store(0, std::memory_order_relaxed);
+
+    // 本线程的预算还给未分配的预算
+    std::lock_guard<std::mutex> lock(registryMutex_);
+    unclaimedBudget_ += maxBytes();
+    maxBytes_.store(0, std::memory_order_relaxed);
+    if(stealCursor_ == this) {
+        stealCursor_ = nextThread_;
+    }
+    // 仍以这个队列为owner的Span可能还有其他线程正在读取owner，所以队列不释放，交给之后新建的线程复用
+    if(remote_) {
+        remote_->nextFree = freeQueues_;
+        freeQueues_ = remote_;
+        remote_ = nullptr;
+    }
+    if(prevThread_) {
+        prevThread_->nextThread_ = nextThread_;
+    }else {
+        registryHead_ = nextThread_;
+    }
+    if(nextThread_) {
+        nextThread_->prevThread_ = prevThread_;
+    }
+    nextThread_ = prevThread_ = nullptr;
+    // 这里不再把registered_置为false：线程清理之后（例如其他thread_local对象析构时）仍有分配/释放的话，
+    // 不会重新注册一个已经析构的清理对象，这部分少量内存块不再归还
 }
 
-} // namespace myMemoryPool
+void ThreadCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(registryMutex_);
+    unclaimedBudget_ += static_cast<ptrdiff_t>(bytes) - static_cast<ptrdiff_t>(budget_);
+    budget_ = bytes;
+}
+
+ThreadCacheStats ThreadCache::getStats() {
+    std::lock_guard<std::mutex> lock(registryMutex_);
+    ThreadCacheStats stats{0, 0, 0, budget_, unclaimedBudget_};
+
+    for(ThreadCache* cache = registryHead_; cache; cache = cache->nextThread_) {
+        size_t bytes = cache->cachedBytes();
+        stats.threadCount ++;
+        stats.cachedBytes += bytes;
+        stats.maxThreadBytes = std::max(stats.maxThreadBytes, bytes);
+    }
+    return stats;
+}
 
+} // namespace myMemoryPool
\ No newline at end of file
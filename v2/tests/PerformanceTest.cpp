@@ -1,10 +1,28 @@
 #include "../include/MemoryPool.h"
+#include "../include/CentralCache.h"
+#include "../include/PageCache.h"
+#include "../include/LargeCache.h"
+#include "../include/CpuCache.h"
+#include "../include/AdaptiveLock.h"
 #include <iostream>
 #include <vector>
 #include <chrono>
 #include <random>
 #include <iomanip>
+#include <cstring>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <map>
+#include <memory>
+#include <cmath>
+#include <string>
+#include <algorithm>
 
 
 using namespace myMemoryPool;
@@ -23,6 +41,47 @@ private:
 };
 
 
+// 读取/proc/self/statm获取当前进程的常驻内存（RSS），单位为字节
+static size_t currentRSS() 
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    statm >> totalPages >> residentPages;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// 读取/proc/self/smaps_rollup获取当前进程使用的透明大页字节数，读取失败时返回0
+static size_t anonHugePages() 
+{
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string key;
+    size_t kb = 0;
+    while (smaps >> key) 
+    {
+        if (key == "AnonHugePages:" && smaps >> kb) return kb * 1024;
+    }
+    return 0;
+}
+
+// 进程到目前为止的缺页（minor fault）次数
+static size_t minorFaults() 
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_minflt);
+}
+
+// 统计/proc/self/maps的行数，即进程当前的内存映射（VMA）数量
+static size_t mappingCount() 
+{
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    size_t count = 0;
+    while (std::getline(maps, line)) ++count;
+    return count;
+}
+
 class PerformanceTest {
 private:
 
@@ -292,6 +351,1580 @@ public:
                       << t.elapsed() << " ms" << std::endl;
         }
     }
+
+    // 5. CentralCache加锁次数测试
+    static void testCentralLockAcquisitions() 
+    {
+        constexpr size_t NUM_THREADS = 4;
+        constexpr size_t ALLOCS_PER_THREAD = 50000;
+        const size_t SIZES[] = {16, 32, 64, 128, 256, 1024, 4096};
+
+        std::cout << "\nTesting CentralCache lock acquisitions (" << NUM_THREADS 
+                  << " threads, " << ALLOCS_PER_THREAD << " allocations each):" 
+                  << std::endl;
+
+        auto threadFunc = [&SIZES]() 
+        {
+            std::vector<std::pair<void*, size_t>> ptrs;
+            ptrs.reserve(ALLOCS_PER_THREAD);
+
+            for (size_t i = 0; i < ALLOCS_PER_THREAD; ++i) 
+            {
+                size_t size = SIZES[rand() % 7];
+                ptrs.emplace_back(MemoryPool::allocate(size), size);
+            }
+
+            for (const auto& [ptr, size] : ptrs) 
+            {
+                MemoryPool::release(ptr, size);
+            }
+        };
+
+        CentralCache& central = CentralCache::getInstance();
+        size_t locksBefore = central.getLockAcquireCount();
+        size_t blocksBefore = central.getFetchedBlockCount();
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < NUM_THREADS; ++i) 
+        {
+            threads.emplace_back(threadFunc);
+        }
+        for (auto& thread : threads) 
+        {
+            thread.join();
+        }
+
+        size_t locks = central.getLockAcquireCount() - locksBefore;
+        size_t blocks = central.getFetchedBlockCount() - blocksBefore;
+
+        // 每次只取一个内存块时，取到的内存块数量即为fetch路径上的加锁次数
+        std::cout << "Blocks fetched from CentralCache: " << blocks << std::endl;
+        std::cout << "Central lock acquisitions (fetch + return): " << locks << std::endl;
+        std::cout << "Blocks per lock acquisition: " << std::fixed << std::setprecision(2) 
+                  << (locks ? static_cast<double>(blocks) / locks : 0.0) << std::endl;
+    }
+
+    // 6. size class内部碎片测试
+    static void testInternalFragmentation() 
+    {
+        constexpr size_t NUM_SAMPLES = 1000000;
+
+        std::cout << "\nTesting internal fragmentation (" << FREE_LIST_SIZE 
+                  << " size classes, ThreadCache metadata " << sizeof(ThreadCache) 
+                  << " bytes per thread):" << std::endl;
+
+        std::mt19937 gen(42);
+        for (size_t maxSize : {size_t(256), size_t(4096), size_t(32 * 1024), MAX_BYTES}) 
+        {
+            std::uniform_int_distribution<size_t> dis(1, maxSize);
+            size_t requested = 0;
+            size_t rounded = 0;
+            size_t aligned = 0; // 按8字节间隔划分size class时的占用
+
+            for (size_t i = 0; i < NUM_SAMPLES; ++i) 
+            {
+                size_t size = dis(gen);
+                requested += size;
+                rounded += SizeClass::roundUp(size);
+                aligned += (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+            }
+
+            std::cout << "Uniform [1, " << maxSize << "]: " << std::fixed << std::setprecision(2)
+                      << 100.0 * (rounded - requested) / rounded << "% wasted (8-byte classes: "
+                      << 100.0 * (aligned - requested) / aligned << "%)" << std::endl;
+        }
+    }
+
+    // 7. 线程首次分配延迟与每线程RSS测试
+    static void testThreadStartup() 
+    {
+        std::cout << "\nTesting first allocation latency and per-thread RSS:" << std::endl;
+
+        for (size_t numThreads : {size_t(1), size_t(100), size_t(10000)}) 
+        {
+            std::vector<double> latencies(numThreads, 0.0);
+            std::atomic<size_t> ready{0};
+            std::mutex mtx;
+            std::condition_variable cv;
+            bool done = false;
+
+            size_t rssBefore = currentRSS();
+            std::vector<std::thread> threads;
+            threads.reserve(numThreads);
+
+            try 
+            {
+                for (size_t i = 0; i < numThreads; ++i) 
+                {
+                    threads.emplace_back([&, i]() 
+                    {
+                        auto start = high_resolution_clock::now();
+                        void* ptr = MemoryPool::allocate(64);
+                        auto end = high_resolution_clock::now();
+                        latencies[i] = duration_cast<nanoseconds>(end - start).count() / 1000.0;
+
+                        // 所有线程同时存活时再统计RSS
+                        ready.fetch_add(1);
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [&done]() { return done; });
+                        lock.unlock();
+
+                        MemoryPool::release(ptr, 64);
+                    });
+                }
+            } 
+            catch (const std::system_error& e) 
+            {
+                std::cout << numThreads << " threads: failed to create thread " << threads.size() 
+                          << " (" << e.what() << ")" << std::endl;
+            }
+
+            while (ready.load() < threads.size()) 
+            {
+                std::this_thread::sleep_for(milliseconds(1));
+            }
+            size_t rssAfter = currentRSS();
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                done = true;
+            }
+            cv.notify_all();
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+
+            size_t created = threads.size();
+            double avgLatency = 0.0;
+            for (size_t i = 0; i < created; ++i) 
+            {
+                avgLatency += latencies[i];
+            }
+            avgLatency /= created;
+
+            std::cout << created << " threads: first allocation " << std::fixed << std::setprecision(3)
+                      << avgLatency << " us avg, RSS " 
+                      << (rssAfter > rssBefore ? (rssAfter - rssBefore) / created : 0) / 1024.0 
+                      << " KB per thread (including stack)" << std::endl;
+        }
+    }
+
+    // 8. 带size释放与无size释放对比测试
+    static void testUnsizedRelease() 
+    {
+        constexpr size_t NUM_ROUNDS = 100;
+        constexpr size_t NUM_ALLOCS = 10000;
+        const size_t SIZES[] = {16, 64, 256, 1024};
+
+        std::cout << "\nTesting sized vs unsized release (" << NUM_ROUNDS * NUM_ALLOCS 
+                  << " releases):" << std::endl;
+
+        std::vector<std::pair<void*, size_t>> ptrs(NUM_ALLOCS);
+
+        for (bool sized : {true, false}) 
+        {
+            double releaseTime = 0.0;
+            for (size_t round = 0; round < NUM_ROUNDS; ++round) 
+            {
+                for (size_t i = 0; i < NUM_ALLOCS; ++i) 
+                {
+                    size_t size = SIZES[i % 4];
+                    ptrs[i] = {MemoryPool::allocate(size), size};
+                }
+
+                // 只统计释放的时间
+                Timer t;
+                if (sized) 
+                {
+                    for (const auto& [ptr, size] : ptrs) 
+                    {
+                        MemoryPool::release(ptr, size);
+                    }
+                } 
+                else 
+                {
+                    for (const auto& [ptr, size] : ptrs) 
+                    {
+                        MemoryPool::release(ptr);
+                    }
+                }
+                releaseTime += t.elapsed();
+            }
+
+            std::cout << (sized ? "Sized release:   " : "Unsized release: ") << std::fixed 
+                      << std::setprecision(3) << releaseTime << " ms (" 
+                      << releaseTime * 1e6 / (NUM_ROUNDS * NUM_ALLOCS) << " ns/op)" << std::endl;
+        }
+    }
+
+    // 9. Span查找开销测试：基数树页表与std::map对比
+    static void testSpanLookup() 
+    {
+        constexpr size_t NUM_LOOKUPS = 1000000;
+        constexpr size_t SPAN_PAGES = 8;
+        using Span = PageCache::Span;
+
+        std::cout << "\nTesting span lookup (" << NUM_LOOKUPS << " random lookups):" << std::endl;
+
+        for (size_t heapGB : {size_t(1), size_t(64)}) 
+        {
+            // 模拟heapGB大小的堆：只构建页表，不真正分配堆内存
+            const size_t numPages = (heapGB << 30) / PageCache::PAGE_SIZE;
+            const size_t numSpans = numPages / SPAN_PAGES;
+            const size_t basePage = PageCache::pageId(reinterpret_cast<void*>(0x7f0000000000));
+
+            std::vector<Span> spans(numSpans);
+            // 页表叶子节点通过mmap申请，测试结束后不回收
+            auto pageMap = std::make_unique<PageMap<PageCache::ADDRESS_BITS - PageCache::PAGE_SHIFT>>();
+            std::map<size_t, Span*> spanMap;
+            pageMap->ensure(basePage, numPages);
+
+            for (size_t i = 0; i < numSpans; ++i) 
+            {
+                spans[i].numPages = SPAN_PAGES;
+                spans[i].sizeClass = i % FREE_LIST_SIZE;
+                for (size_t j = 0; j < SPAN_PAGES; ++j) 
+                {
+                    pageMap->set(basePage + i * SPAN_PAGES + j, &spans[i]);
+                }
+                spanMap[basePage + i * SPAN_PAGES] = &spans[i];
+            }
+
+            std::mt19937_64 gen(42);
+            std::uniform_int_distribution<size_t> dis(0, numPages - 1);
+            std::vector<size_t> pages(NUM_LOOKUPS);
+            for (auto& page : pages) 
+            {
+                page = basePage + dis(gen);
+            }
+
+            size_t checksum = 0;
+            double radixTime = 0.0;
+            {
+                Timer t;
+                for (size_t page : pages) 
+                {
+                    checksum += static_cast<Span*>(pageMap->get(page))->sizeClass;
+                }
+                radixTime = t.elapsed();
+            }
+
+            double mapTime = 0.0;
+            {
+                Timer t;
+                for (size_t page : pages) 
+                {
+                    // 查找起始页号小于等于page的最后一个Span
+                    checksum -= std::prev(spanMap.upper_bound(page))->second->sizeClass;
+                }
+                mapTime = t.elapsed();
+            }
+
+            std::cout << heapGB << "GB heap: radix page map " << std::fixed << std::setprecision(2)
+                      << radixTime * 1e6 / NUM_LOOKUPS << " ns/lookup, std::map "
+                      << mapTime * 1e6 / NUM_LOOKUPS << " ns/lookup"
+                      << (checksum == 0 ? "" : " (mismatch!)") << std::endl;
+        }
+    }
+
+    // 10. PageCache长时间运行的碎片化测试（压缩时间的Span分配/释放混合负载）
+    static void testSpanFragmentation() 
+    {
+        constexpr size_t NUM_ROUNDS = 100;
+        constexpr size_t OPS_PER_ROUND = 10000;
+        constexpr size_t MAX_LIVE_SPANS = 1000;
+
+        std::cout << "\nTesting PageCache fragmentation (" << NUM_ROUNDS * OPS_PER_ROUND 
+                  << " span operations, up to " << MAX_LIVE_SPANS << " live spans):" << std::endl;
+
+        PageCache& pageCache = PageCache::getInstance();
+        size_t mmapBefore = pageCache.getSystemAllocCount();
+
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<size_t> smallPages(1, 32);
+        std::uniform_int_distribution<size_t> largePages(64, 256);
+        std::vector<std::pair<void*, size_t>> live;
+        live.reserve(MAX_LIVE_SPANS);
+
+        Timer t;
+        for (size_t round = 0; round < NUM_ROUNDS; ++round) 
+        {
+            for (size_t op = 0; op < OPS_PER_ROUND; ++op) 
+            {
+                if (live.size() < MAX_LIVE_SPANS && (live.empty() || gen() % 2 == 0)) 
+                {
+                    // 5%的大Span
+                    size_t numPages = gen() % 20 == 0 ? largePages(gen) : smallPages(gen);
+                    live.emplace_back(pageCache.allocateSpan(numPages, 0), numPages);
+                } 
+                else 
+                {
+                    size_t index = gen() % live.size();
+                    pageCache.releaseSpan(live[index].first, live[index].second);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+            }
+        }
+        double elapsed = t.elapsed();
+
+        std::cout << "Churn time: " << std::fixed << std::setprecision(3) << elapsed << " ms" << std::endl;
+        std::cout << "mmap calls: " << pageCache.getSystemAllocCount() - mmapBefore << std::endl;
+        std::cout << "Free pages: " << pageCache.getFreePages() 
+                  << ", largest free span: " << pageCache.getLargestFreeSpan() << " pages" << std::endl;
+
+        for (const auto& [ptr, numPages] : live) 
+        {
+            pageCache.releaseSpan(ptr, numPages);
+        }
+        std::cout << "After releasing all spans: free pages " << pageCache.getFreePages() 
+                  << ", largest free span: " << pageCache.getLargestFreeSpan() << " pages" << std::endl;
+    }
+
+    // 11. 流量尖峰前后的RSS测试：空闲页归还给操作系统
+    static void testReleaseAfterSpike() 
+    {
+        constexpr size_t SPIKE_BYTES = 256 * 1024 * 1024;
+        constexpr size_t SPAN_PAGES = 64;
+        constexpr size_t NUM_SPANS = SPIKE_BYTES / (SPAN_PAGES * PageCache::PAGE_SIZE);
+
+        std::cout << "\nTesting RSS around a " << SPIKE_BYTES / (1024 * 1024) << "MB spike:" << std::endl;
+
+        PageCache& pageCache = PageCache::getInstance();
+        auto spike = [&pageCache]() 
+        {
+            std::vector<void*> spans;
+            spans.reserve(NUM_SPANS);
+            for (size_t i = 0; i < NUM_SPANS; ++i) 
+            {
+                void* span = pageCache.allocateSpan(SPAN_PAGES, 0);
+                memset(span, 1, SPAN_PAGES * PageCache::PAGE_SIZE);
+                spans.push_back(span);
+            }
+            size_t peak = currentRSS();
+            for (void* span : spans) 
+            {
+                pageCache.releaseSpan(span, SPAN_PAGES);
+            }
+            return peak;
+        };
+        auto toMB = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "RSS before spike: " << toMB(currentRSS()) << " MB" << std::endl;
+        std::cout << "RSS at peak: " << toMB(spike()) << " MB" << std::endl;
+        std::cout << "RSS after spike: " << toMB(currentRSS()) << " MB" << std::endl;
+
+        {
+            Timer t;
+            size_t released = MemoryPool::releaseFreeMemory();
+            std::cout << "RSS after releaseFreeMemory(): " << toMB(currentRSS()) << " MB (released "
+                      << toMB(released) << " MB in " << std::setprecision(3) << t.elapsed() << " ms)" 
+                      << std::setprecision(1) << std::endl;
+        }
+
+        // 自动归还：1GB/s，空闲100ms以上的Span会在之后的releaseSpan中被归还
+        pageCache.setReleaseRate(1024 * 1024 * 1024, 100);
+        std::cout << "RSS at second peak (reusing released pages): " << toMB(spike()) << " MB" << std::endl;
+        std::this_thread::sleep_for(milliseconds(400));
+        pageCache.releaseSpan(pageCache.allocateSpan(1, 0), 1);
+        std::cout << "RSS after idle release (1GB/s, 100ms idle): " << toMB(currentRSS()) << " MB" << std::endl;
+        pageCache.setReleaseRate(0);
+    }
+
+    // 12. 负载阶段切换测试：小对象全部释放后，Span归还PageCache供大对象复用
+    static void testPhaseShift() 
+    {
+        constexpr size_t PHASE_BYTES = 128 * 1024 * 1024;
+        constexpr size_t SMALL_SIZE = 32;
+        constexpr size_t LARGE_SIZE = 4096;
+
+        std::cout << "\nTesting phase shift (" << PHASE_BYTES / (1024 * 1024) << "MB of " << SMALL_SIZE 
+                  << "-byte objects, then " << LARGE_SIZE << "-byte objects):" << std::endl;
+
+        PageCache& pageCache = PageCache::getInstance();
+        auto toMB = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+        size_t freeAtPeak = 0;
+        auto phase = [&pageCache, &freeAtPeak](size_t size) 
+        {
+            std::vector<void*> ptrs;
+            ptrs.reserve(PHASE_BYTES / size);
+            for (size_t i = 0; i < PHASE_BYTES / size; ++i) 
+            {
+                void* ptr = MemoryPool::allocate(size);
+                memset(ptr, 1, size);
+                ptrs.push_back(ptr);
+            }
+            size_t peak = currentRSS();
+            freeAtPeak = pageCache.getFreePages();
+            for (void* ptr : ptrs) 
+            {
+                MemoryPool::release(ptr, size);
+            }
+            return peak;
+        };
+
+        // 先把之前测试留下的空闲页归还给操作系统，以免影响RSS统计
+        MemoryPool::releaseFreeMemory();
+        size_t rssBefore = currentRSS();
+        size_t mmapBefore = pageCache.getSystemAllocCount();
+
+        size_t smallPeak = phase(SMALL_SIZE);
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Small phase peak RSS: +" << toMB(smallPeak - rssBefore) << " MB" << std::endl;
+        std::cout << "Returned to PageCache after small phase: " 
+                  << toMB((pageCache.getFreePages() - freeAtPeak) * PageCache::PAGE_SIZE) << " MB" << std::endl;
+
+        size_t largePeak = phase(LARGE_SIZE);
+        std::cout << "Large phase peak RSS: +" << toMB(largePeak - rssBefore) << " MB" << std::endl;
+        std::cout << "mmap calls across both phases: " << pageCache.getSystemAllocCount() - mmapBefore << std::endl;
+    }
+
+    // 13. 线程创建/销毁测试：线程退出时归还缓存的内存块
+    static void testThreadChurn() 
+    {
+        constexpr size_t NUM_ROUNDS = 400;
+        constexpr size_t THREADS_PER_ROUND = 8;
+        constexpr size_t ALLOCS_PER_THREAD = 2000;
+
+        std::cout << "\nTesting thread churn (" << NUM_ROUNDS << " rounds of " << THREADS_PER_ROUND 
+                  << " short-lived threads):" << std::endl;
+
+        auto threadFunc = []() 
+        {
+            std::mt19937 gen(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            std::uniform_int_distribution<size_t> dis(8, 4096);
+            std::vector<std::pair<void*, size_t>> ptrs;
+            ptrs.reserve(ALLOCS_PER_THREAD);
+
+            for (size_t i = 0; i < ALLOCS_PER_THREAD; ++i) 
+            {
+                size_t size = dis(gen);
+                ptrs.emplace_back(MemoryPool::allocate(size), size);
+            }
+            // 全部释放后，内存块留在本线程的ThreadCache中，直到线程退出
+            for (const auto& [ptr, size] : ptrs) 
+            {
+                MemoryPool::release(ptr, size);
+            }
+        };
+
+        size_t rssBefore = currentRSS();
+        std::cout << std::fixed << std::setprecision(1);
+        Timer t;
+        for (size_t round = 1; round <= NUM_ROUNDS; ++round) 
+        {
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < THREADS_PER_ROUND; ++i) 
+            {
+                threads.emplace_back(threadFunc);
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+
+            if (round % 100 == 0) 
+            {
+                ThreadCacheStats stats = ThreadCache::getStats();
+                size_t rss = currentRSS();
+                std::cout << "Round " << round << ": RSS +" 
+                          << (rss > rssBefore ? rss - rssBefore : 0) / 1024.0 << " KB, live thread caches "
+                          << stats.threadCount << ", cached " << stats.cachedBytes / 1024.0 << " KB" << std::endl;
+            }
+        }
+        std::cout << "Churn time: " << std::setprecision(3) << t.elapsed() << " ms" << std::endl;
+    }
+    // 14. 大对象缓冲区反复申请/释放测试：512KB~16MB，与系统malloc对比
+    static void testLargeBufferChurn() 
+    {
+        constexpr size_t NUM_OPS = 4000;
+        constexpr size_t LIVE_BUFFERS = 8;
+        constexpr size_t MIN_SIZE = 512 * 1024;
+        constexpr size_t MAX_SIZE = 16 * 1024 * 1024;
+
+        std::cout << "\nTesting large buffer churn (" << NUM_OPS << " ops, " << MIN_SIZE / 1024 << "KB-" 
+                  << MAX_SIZE / (1024 * 1024) << "MB, " << LIVE_BUFFERS << " live buffers):" << std::endl;
+
+        // 预先生成大小序列，保证两边负载一致；大小按对数均匀分布
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> dis(std::log2(double(MIN_SIZE)), std::log2(double(MAX_SIZE)));
+        std::vector<size_t> sizes(NUM_OPS);
+        for (auto& size : sizes) 
+        {
+            size = static_cast<size_t>(std::exp2(dis(gen)));
+        }
+
+        // 每页写一个字节，模拟缓冲区被真正使用（包含缺页开销）
+        auto touch = [](void* ptr, size_t size) 
+        {
+            char* p = static_cast<char*>(ptr);
+            for (size_t offset = 0; offset < size; offset += PageCache::PAGE_SIZE) 
+            {
+                p[offset] = 1;
+            }
+        };
+
+        auto runPool = [&]() 
+        {
+            std::vector<std::pair<void*, size_t>> live(LIVE_BUFFERS, {nullptr, 0});
+            Timer t;
+            for (size_t i = 0; i < NUM_OPS; ++i) 
+            {
+                auto& slot = live[i % LIVE_BUFFERS];
+                if (slot.first) MemoryPool::release(slot.first, slot.second);
+                slot = {MemoryPool::allocate(sizes[i]), sizes[i]};
+                touch(slot.first, slot.second);
+            }
+            for (auto& [ptr, size] : live) 
+            {
+                MemoryPool::release(ptr, size);
+            }
+            return t.elapsed();
+        };
+        auto runMalloc = [&]() 
+        {
+            std::vector<void*> live(LIVE_BUFFERS, nullptr);
+            Timer t;
+            for (size_t i = 0; i < NUM_OPS; ++i) 
+            {
+                void*& slot = live[i % LIVE_BUFFERS];
+                free(slot);
+                slot = malloc(sizes[i]);
+                touch(slot, sizes[i]);
+            }
+            for (void* ptr : live) 
+            {
+                free(ptr);
+            }
+            return t.elapsed();
+        };
+
+        // 先各跑一遍不计时：之前的测试可能已经把内存池的空闲页归还给操作系统（releaseFreeMemory），
+        // 而glibc的堆已经被之前的测试填满，不预热时比较的主要是两边第一次访问物理页的缺页次数
+        runPool();
+        runMalloc();
+
+        PageCache& pageCache = PageCache::getInstance();
+        LargeCache& largeCache = LargeCache::getInstance();
+        size_t allocsBefore = pageCache.getSystemAllocCount();
+        size_t hitBefore = largeCache.getHitCount();
+        size_t missBefore = largeCache.getMissCount();
+
+        size_t faults = minorFaults();
+        double poolTime = runPool();
+        size_t poolFaults = minorFaults() - faults;
+        faults = minorFaults();
+        double mallocTime = runMalloc();
+        size_t mallocFaults = minorFaults() - faults;
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Memory Pool: " << poolTime << " ms (" << poolTime * 1000.0 / NUM_OPS << " us/op, " 
+                  << poolFaults << " page faults)" << std::endl;
+        std::cout << "Malloc/Free: " << mallocTime << " ms (" << mallocTime * 1000.0 / NUM_OPS << " us/op, " 
+                  << mallocFaults << " page faults)" << std::endl;
+        std::cout << "Large cache hits: " << largeCache.getHitCount() - hitBefore 
+                  << ", misses: " << largeCache.getMissCount() - missBefore 
+                  << ", mmap calls: " << pageCache.getSystemAllocCount() - allocsBefore 
+                  << ", cached: " << std::setprecision(1) << largeCache.getCachedBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+    // 15. 大页模式测试：在内存池分配的大型链表上随机游走，对比dTLB未命中带来的开销
+    static void testHugePageWalk() 
+    {
+        constexpr size_t NODE_SIZE = 64;
+        constexpr size_t NUM_NODES = 2 * 1024 * 1024; // 128MB
+        constexpr size_t NUM_STEPS = 5 * 1000 * 1000;
+
+        std::cout << "\nTesting random walk over " << NUM_NODES * NODE_SIZE / (1024 * 1024) 
+                  << "MB of pool-allocated nodes:" << std::endl;
+
+        struct Node 
+        {
+            Node* next;
+            char payload[NODE_SIZE - sizeof(Node*)];
+        };
+
+        PageCache& pageCache = PageCache::getInstance();
+
+        // 先把PageCache中已有的空闲页全部取走，保证链表的内存都来自新申请的系统内存
+        std::vector<std::pair<void*, size_t>> drained;
+        auto drain = [&]() 
+        {
+            while (size_t pages = pageCache.getLargestFreeSpan()) 
+            {
+                drained.emplace_back(pageCache.allocateSpan(pages, 0), pages);
+            }
+        };
+
+        // 按随机顺序把节点串成一个环，每一步都访问一个随机的页
+        auto build = [](std::vector<Node*>& nodes) 
+        {
+            nodes.resize(NUM_NODES);
+            for (auto& node : nodes) 
+            {
+                node = static_cast<Node*>(MemoryPool::allocate(NODE_SIZE));
+            }
+            std::vector<Node*> order(nodes);
+            std::shuffle(order.begin(), order.end(), std::mt19937(42));
+            for (size_t i = 0; i < NUM_NODES; ++i) 
+            {
+                order[i]->next = order[(i + 1) % NUM_NODES];
+            }
+        };
+
+        auto walk = [](Node* start) 
+        {
+            Node* node = start;
+            Timer t;
+            for (size_t i = 0; i < NUM_STEPS; ++i) 
+            {
+                node = node->next;
+            }
+            double ms = t.elapsed();
+            // 防止编译器把循环优化掉
+            if (node == nullptr) std::cout << "";
+            return ms;
+        };
+
+        size_t hugeBefore = anonHugePages();
+
+        std::vector<Node*> smallNodes;
+        drain();
+        build(smallNodes);
+
+        std::vector<Node*> hugeNodes;
+        drain();
+        pageCache.setHugePageMode(true);
+        build(hugeNodes);
+        pageCache.setHugePageMode(false);
+
+        size_t hugeBytes = anonHugePages() - std::min(anonHugePages(), hugeBefore);
+
+        std::cout << std::fixed << std::setprecision(3);
+        double smallTime = walk(smallNodes[0]);
+        double hugeTime = walk(hugeNodes[0]);
+        std::cout << "4KB pages: " << smallTime << " ms (" << smallTime * 1e6 / NUM_STEPS << " ns/step)" << std::endl;
+        std::cout << "Huge page mode: " << hugeTime << " ms (" << hugeTime * 1e6 / NUM_STEPS << " ns/step)" << std::endl;
+        std::cout << "Transparent huge pages in use: " << std::setprecision(1) << hugeBytes / (1024.0 * 1024.0) 
+                  << " MB, MAP_HUGETLB regions: " << pageCache.getHugetlbAllocCount() << std::endl;
+
+        for (Node* node : smallNodes) MemoryPool::release(node, NODE_SIZE);
+        for (Node* node : hugeNodes) MemoryPool::release(node, NODE_SIZE);
+        for (const auto& [span, pages] : drained) pageCache.releaseSpan(span, pages);
+    }
+    // 16. 清零相关测试：新申请系统内存的开销，以及calloc密集负载与系统calloc对比
+    static void testZeroedAllocation() 
+    {
+        constexpr size_t SPAN_PAGES = 64;
+        constexpr size_t FRESH_BYTES = 256 * 1024 * 1024;
+        constexpr size_t NUM_SPANS = FRESH_BYTES / (SPAN_PAGES * PageCache::PAGE_SIZE);
+
+        std::cout << "\nTesting zeroed allocation:" << std::endl;
+
+        PageCache& pageCache = PageCache::getInstance();
+
+        // 先取走所有空闲页，之后的Span都来自新申请的系统内存
+        std::vector<std::pair<void*, size_t>> drained;
+        while (size_t pages = pageCache.getLargestFreeSpan()) 
+        {
+            drained.emplace_back(pageCache.allocateSpan(pages, 0), pages);
+        }
+
+        std::cout << std::fixed << std::setprecision(3);
+        {
+            std::vector<void*> spans;
+            spans.reserve(NUM_SPANS);
+            size_t rssBefore = currentRSS();
+            Timer t;
+            for (size_t i = 0; i < NUM_SPANS; ++i) 
+            {
+                spans.push_back(pageCache.allocateSpan(SPAN_PAGES, 0));
+            }
+            double ms = t.elapsed();
+            size_t rss = currentRSS();
+            std::cout << "Fresh spans (" << FRESH_BYTES / (1024 * 1024) << "MB): " << ms << " ms, RSS +" 
+                      << std::setprecision(1) << (rss > rssBefore ? rss - rssBefore : 0) / (1024.0 * 1024.0) 
+                      << " MB" << std::setprecision(3) << std::endl;
+            for (void* span : spans) 
+            {
+                pageCache.releaseSpan(span, SPAN_PAGES);
+            }
+        }
+        for (const auto& [span, pages] : drained) 
+        {
+            pageCache.releaseSpan(span, pages);
+        }
+
+        // calloc密集负载：小对象为主，夹杂大对象，每页写一个字节
+        constexpr size_t NUM_OPS = 200000;
+        constexpr size_t LIVE = 64;
+        std::mt19937 gen(7);
+        std::uniform_int_distribution<size_t> smallDis(16, 4096);
+        std::uniform_int_distribution<size_t> largeDis(512 * 1024, 4 * 1024 * 1024);
+        std::vector<size_t> sizes(NUM_OPS);
+        for (size_t i = 0; i < NUM_OPS; ++i) 
+        {
+            sizes[i] = (i % 100 == 0) ? largeDis(gen) : smallDis(gen);
+        }
+
+        auto run = [&](auto allocFunc, auto freeFunc) 
+        {
+            std::vector<std::pair<void*, size_t>> live(LIVE, {nullptr, 0});
+            Timer t;
+            for (size_t i = 0; i < NUM_OPS; ++i) 
+            {
+                auto& slot = live[i % LIVE];
+                if (slot.first) freeFunc(slot.first, slot.second);
+                char* p = static_cast<char*>(allocFunc(sizes[i]));
+                for (size_t offset = 0; offset < sizes[i]; offset += PageCache::PAGE_SIZE) 
+                {
+                    p[offset] = 1;
+                }
+                slot = {p, sizes[i]};
+            }
+            for (auto& [ptr, size] : live) 
+            {
+                freeFunc(ptr, size);
+            }
+            return t.elapsed();
+        };
+
+        size_t skipped = ThreadCache::getInstance()->zeroSkipCount();
+        double poolTime = run([](size_t size) { return MemoryPool::allocateZeroed(size); },
+                              [](void* ptr, size_t size) { MemoryPool::release(ptr, size); });
+        skipped = ThreadCache::getInstance()->zeroSkipCount() - skipped;
+        double callocTime = run([](size_t size) { return calloc(1, size); },
+                                [](void* ptr, size_t) { free(ptr); });
+        std::cout << "calloc-heavy workload (" << NUM_OPS << " ops, 1% large):" << std::endl;
+        std::cout << "Memory Pool allocateZeroed: " << poolTime << " ms (" << skipped << " allocations skipped zeroing)" << std::endl;
+        std::cout << "System calloc: " << callocTime << " ms" << std::endl;
+    }
+    // 17. 堆增长测试：从预留的地址范围中切分新页，与每个Span单独mmap对比系统调用和VMA数量
+    static void testHeapGrowth() 
+    {
+        constexpr size_t NUM_SPANS = 20000;
+
+        std::cout << "\nTesting heap growth (" << NUM_SPANS << " fresh spans of 1-64 pages):" << std::endl;
+
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<size_t> dis(1, 64);
+        std::vector<size_t> pages(NUM_SPANS);
+        for (auto& n : pages) n = dis(gen);
+
+        PageCache& pageCache = PageCache::getInstance();
+        std::vector<std::pair<void*, size_t>> drained;
+        while (size_t n = pageCache.getLargestFreeSpan()) 
+        {
+            drained.emplace_back(pageCache.allocateSpan(n, 0), n);
+        }
+
+        std::vector<void*> spans(NUM_SPANS);
+        size_t allocBefore = pageCache.getSystemAllocCount();
+        size_t mapsBefore = mappingCount();
+        Timer poolTimer;
+        for (size_t i = 0; i < NUM_SPANS; ++i) 
+        {
+            spans[i] = pageCache.allocateSpan(pages[i], 0);
+        }
+        double poolTime = poolTimer.elapsed();
+        size_t poolCalls = pageCache.getSystemAllocCount() - allocBefore;
+        size_t poolMaps = mappingCount() - std::min(mappingCount(), mapsBefore);
+        for (size_t i = 0; i < NUM_SPANS; ++i) 
+        {
+            pageCache.releaseSpan(spans[i], pages[i]);
+        }
+        for (const auto& [span, n] : drained) 
+        {
+            pageCache.releaseSpan(span, n);
+        }
+
+        mapsBefore = mappingCount();
+        Timer mmapTimer;
+        for (size_t i = 0; i < NUM_SPANS; ++i) 
+        {
+            spans[i] = mmap(nullptr, pages[i] * PageCache::PAGE_SIZE, PROT_READ | PROT_WRITE, 
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        double mmapTime = mmapTimer.elapsed();
+        size_t mmapMaps = mappingCount() - std::min(mappingCount(), mapsBefore);
+        for (size_t i = 0; i < NUM_SPANS; ++i) 
+        {
+            munmap(spans[i], pages[i] * PageCache::PAGE_SIZE);
+        }
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Reserved range: " << poolTime << " ms, " << poolCalls << " system calls, +" 
+                  << poolMaps << " mappings" << std::endl;
+        std::cout << "mmap per span: " << mmapTime << " ms, " << NUM_SPANS << " system calls, +" 
+                  << mmapMaps << " mappings" << std::endl;
+    }
+    // 18. per-thread与per-CPU缓存对比：线程数远多于CPU核数时的吞吐量与缓存内存
+    static void testPerCpuMode() 
+    {
+        constexpr size_t NUM_THREADS = 512;
+        constexpr size_t ROUNDS = 20;
+        constexpr size_t WORKING_SET = 256;
+
+        std::cout << "\nTesting per-thread vs per-CPU caches (" << NUM_THREADS << " threads on " 
+                  << std::thread::hardware_concurrency() << " CPUs):" << std::endl;
+
+        auto run = [](const char* name) 
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            size_t finished = 0;
+            bool exit = false;
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < NUM_THREADS; ++i) 
+            {
+                threads.emplace_back([&, i]() 
+                {
+                    std::mt19937 gen(i);
+                    std::uniform_int_distribution<size_t> dis(16, 1024);
+                    std::vector<std::pair<void*, size_t>> ptrs(WORKING_SET);
+                    for (size_t round = 0; round < ROUNDS; ++round) 
+                    {
+                        for (auto& [ptr, size] : ptrs) 
+                        {
+                            size = dis(gen);
+                            ptr = MemoryPool::allocate(size);
+                        }
+                        for (const auto& [ptr, size] : ptrs) 
+                        {
+                            MemoryPool::release(ptr, size);
+                        }
+                    }
+
+                    // 所有线程都完成之后统计缓存的内存，统计完再退出
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (++finished == NUM_THREADS) cv.notify_all();
+                    cv.wait(lock, [&]() { return exit; });
+                });
+            }
+
+            double ms = 0.0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return finished == NUM_THREADS; });
+                ms = t.elapsed();
+                size_t threadBytes = ThreadCache::getStats().cachedBytes;
+                size_t cpuBytes = CpuCache::getInstance().cachedBytes();
+                std::cout << name << ": " << std::setprecision(3) << ms << " ms, cached " << std::setprecision(1)
+                          << (threadBytes + cpuBytes) / 1024.0 << " KB (thread caches " << threadBytes / 1024.0
+                          << " KB, CPU caches " << cpuBytes / 1024.0 << " KB)" << std::endl;
+                exit = true;
+                cv.notify_all();
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+        };
+
+        std::cout << std::fixed;
+        run("Per-thread");
+        if (!MemoryPool::setPerCpuMode(true)) 
+        {
+            std::cout << "Per-CPU mode not supported on this system" << std::endl;
+            return;
+        }
+        run("Per-CPU");
+        MemoryPool::setPerCpuMode(false);
+    }
+    // 19. CentralCache单一size class争用测试：所有线程反复申请/归还同一个size class的批次，统计延迟分布
+    static void testCentralContention() 
+    {
+        constexpr size_t NUM_THREADS = 8;
+        constexpr size_t OPS_PER_THREAD = 50000;
+        const size_t index = SizeClass::getIndex(64);
+        const size_t fullBatch = SizeClass::numMoveSize(SizeClass::classSize(index));
+
+        std::cout << "\nTesting CentralCache contention (" << NUM_THREADS << " threads, one size class, " 
+                  << OPS_PER_THREAD << " fetch+return per thread):" << std::endl;
+
+        // 每个线程同时持有held个完整批次：持有的批次数不超过转移缓存的容量时都由无锁的转移缓存满足，
+        // 超过时转移缓存交替为空/溢出，多出的部分落到加锁的Span链表；locks为Span链表的加锁次数
+        auto run = [&](const char* name, size_t held) 
+        {
+            CentralCache& centralCache = CentralCache::getInstance();
+            centralCache.flush();
+            std::vector<std::vector<double>> latencies(NUM_THREADS);
+            size_t locksBefore = centralCache.getLockAcquireCount();
+            size_t contendedBefore = centralCache.getLockStats().contended.load();
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < NUM_THREADS; ++i) 
+            {
+                threads.emplace_back([&, i]() 
+                {
+                    auto& samples = latencies[i];
+                    samples.reserve(OPS_PER_THREAD);
+                    std::vector<void*> batches(held * MAX_BATCH_NUM);
+                    std::vector<size_t> counts(held);
+                    for (size_t op = 0; op < OPS_PER_THREAD; op += held) 
+                    {
+                        auto begin = steady_clock::now();
+                        for (size_t b = 0; b < held; ++b) 
+                        {
+                            counts[b] = centralCache.fetchRange(&batches[b * MAX_BATCH_NUM], fullBatch, index);
+                        }
+                        for (size_t b = 0; b < held; ++b) 
+                        {
+                            centralCache.returnMemory(&batches[b * MAX_BATCH_NUM], counts[b], index);
+                        }
+                        samples.push_back(duration_cast<nanoseconds>(steady_clock::now() - begin).count() / 1000.0 / held);
+                    }
+                });
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+            double ms = t.elapsed();
+
+            std::vector<double> all;
+            for (const auto& samples : latencies) 
+            {
+                all.insert(all.end(), samples.begin(), samples.end());
+            }
+            std::sort(all.begin(), all.end());
+            auto percentile = [&](double p) { return all[static_cast<size_t>(p * (all.size() - 1))]; };
+
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << name << ": " << ms << " ms, p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) 
+                      << " us, p99.9 " << percentile(0.999) << " us, max " << all.back() << " us, locks " 
+                      << centralCache.getLockAcquireCount() - locksBefore << ", contended " 
+                      << centralCache.getLockStats().contended.load() - contendedBefore << std::endl;
+        };
+
+        run("Transfer cache (1 batch held)   ", 1);
+        run("Span lists (16 batches held)    ", 2 * CentralCache::MAX_CACHED_BATCHES);
+    }
+    // 20. 锁等待/持有时间分布测试：线程数多于CPU核数时CentralCache和PageCache的锁
+    static void testLockProfile() 
+    {
+        constexpr size_t NUM_THREADS = 32;
+        constexpr size_t OPS_PER_THREAD = 20000;
+        constexpr size_t WORKING_SET = 512;
+
+        std::cout << "\nTesting lock wait/hold times (" << NUM_THREADS << " threads on " 
+                  << std::thread::hardware_concurrency() << " CPUs):" << std::endl;
+
+        LockStats& centralStats = CentralCache::getInstance().getLockStats();
+        LockStats& pageStats = PageCache::getInstance().getLockStats();
+        LockStats& largeStats = LargeCache::getInstance().getLockStats();
+        centralStats.reset();
+        pageStats.reset();
+        largeStats.reset();
+        AdaptiveLock::setProfiling(true);
+
+        Timer t;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < NUM_THREADS; ++i) 
+        {
+            threads.emplace_back([i]() 
+            {
+                std::mt19937 gen(i);
+                std::uniform_int_distribution<size_t> dis(16, 32 * 1024);
+                // 每64次操作有一次大对象，经过LargeCache的锁
+                std::uniform_int_distribution<size_t> largeDis(MAX_BYTES + 1, 1024 * 1024);
+                std::vector<std::pair<void*, size_t>> ptrs(WORKING_SET, {nullptr, 0});
+                for (size_t op = 0; op < OPS_PER_THREAD; ++op) 
+                {
+                    auto& [ptr, size] = ptrs[gen() % WORKING_SET];
+                    if (ptr) MemoryPool::release(ptr, size);
+                    size = op % 64 == 0 ? largeDis(gen) : dis(gen);
+                    ptr = MemoryPool::allocate(size);
+                }
+                for (const auto& [ptr, size] : ptrs) 
+                {
+                    if (ptr) MemoryPool::release(ptr, size);
+                }
+            });
+        }
+        for (auto& thread : threads) 
+        {
+            thread.join();
+        }
+        double ms = t.elapsed();
+        AdaptiveLock::setProfiling(false);
+
+        auto report = [](const char* name, const LockStats& stats) 
+        {
+            std::cout << name << ": " << LockStats::total(stats.holdNs) << " acquisitions, " 
+                      << stats.contended.load() << " contended, " << stats.parked.load() << " parked" << std::endl;
+            std::cout << "  wait p50/p99/p99.9: <" << LockStats::percentile(stats.waitNs, 0.5) << " / <" 
+                      << LockStats::percentile(stats.waitNs, 0.99) << " / <" 
+                      << LockStats::percentile(stats.waitNs, 0.999) << " ns" << std::endl;
+            std::cout << "  hold p50/p99/p99.9: <" << LockStats::percentile(stats.holdNs, 0.5) << " / <" 
+                      << LockStats::percentile(stats.holdNs, 0.99) << " / <" 
+                      << LockStats::percentile(stats.holdNs, 0.999) << " ns" << std::endl;
+        };
+        std::cout << std::fixed << std::setprecision(3) << "Total time: " << ms << " ms" << std::endl;
+        report("CentralCache locks", centralStats);
+        report("PageCache lock", pageStats);
+        report("LargeCache lock", largeStats);
+    }
+    // 21. 线程数扩展测试：1~64个线程反复分配/释放64字节的对象，统计总吞吐量
+    static void testThreadScaling() 
+    {
+        constexpr size_t OPS_PER_THREAD = 200000;
+        constexpr size_t WORKING_SET = 1000;
+        constexpr size_t SIZE = 64;
+
+        std::cout << "\nTesting throughput scaling (" << SIZE << "-byte objects, " 
+                  << CentralCache::getInstance().shardCount() << " central shards, " 
+                  << std::thread::hardware_concurrency() << " CPUs):" << std::endl;
+
+        size_t stealBefore = CentralCache::getInstance().getStealCount();
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t numThreads : {1, 2, 4, 8, 16, 32, 64}) 
+        {
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < numThreads; ++i) 
+            {
+                threads.emplace_back([]() 
+                {
+                    std::vector<void*> ptrs(WORKING_SET);
+                    for (size_t op = 0; op < OPS_PER_THREAD; op += 2 * WORKING_SET) 
+                    {
+                        for (auto& ptr : ptrs) ptr = MemoryPool::allocate(SIZE);
+                        for (void* ptr : ptrs) MemoryPool::release(ptr, SIZE);
+                    }
+                });
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+            double ms = t.elapsed();
+            std::cout << std::setw(2) << numThreads << " threads: " << std::setw(8) 
+                      << numThreads * OPS_PER_THREAD / ms / 1000.0 << " Mops/s" << std::endl;
+        }
+        std::cout << "Cross-shard steals: " << CentralCache::getInstance().getStealCount() - stealBefore << std::endl;
+    }
+    // 22. 跨线程释放测试：生产者线程分配并写入对象，交给消费者线程读取后释放
+    // 生产者的ThreadCache不断向CentralCache申请，消费者不断归还，内存块经转移缓存在两个线程之间流转
+    static void testCrossThreadFree() 
+    {
+        constexpr size_t NUM_PAIRS = 4;
+        constexpr size_t ROUNDS = 2000;
+        constexpr size_t BATCH = 256;
+        constexpr size_t SIZE = 64;
+
+        std::cout << "\nTesting cross-thread free (" << NUM_PAIRS << " producer/consumer pairs, " 
+                  << ROUNDS * BATCH << " objects of " << SIZE << " bytes per pair):" << std::endl;
+
+        auto run = [&](const char* name, auto alloc, auto dealloc) 
+        {
+            CentralCache& centralCache = CentralCache::getInstance();
+            size_t locksBefore = centralCache.getLockAcquireCount();
+            size_t hitsBefore = centralCache.getTransferHitCount();
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t pair = 0; pair < NUM_PAIRS; ++pair) 
+            {
+                // 每对线程通过一个单槽信箱交接一批对象，生产者写入之后等待消费者取走
+                auto mailbox = std::make_shared<std::atomic<std::vector<void*>*>>(nullptr);
+                threads.emplace_back([=]() 
+                {
+                    for (size_t round = 0; round < ROUNDS; ++round) 
+                    {
+                        auto* ptrs = new std::vector<void*>(BATCH);
+                        for (auto& ptr : *ptrs) 
+                        {
+                            ptr = alloc(SIZE);
+                            static_cast<char*>(ptr)[0] = static_cast<char>(round);
+                        }
+                        std::vector<void*>* expected = nullptr;
+                        while (!mailbox->compare_exchange_weak(expected, ptrs, std::memory_order_release)) 
+                        {
+                            expected = nullptr;
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+                threads.emplace_back([=]() 
+                {
+                    for (size_t round = 0; round < ROUNDS; ++round) 
+                    {
+                        std::vector<void*>* ptrs = nullptr;
+                        while (!(ptrs = mailbox->exchange(nullptr, std::memory_order_acquire))) 
+                        {
+                            std::this_thread::yield();
+                        }
+                        for (void* ptr : *ptrs) 
+                        {
+                            if (static_cast<char*>(ptr)[0] != static_cast<char>(round)) std::abort();
+                            dealloc(ptr, SIZE);
+                        }
+                        delete ptrs;
+                    }
+                });
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+            double ms = t.elapsed();
+
+            std::cout << name << ": " << std::fixed << std::setprecision(3) << ms << " ms, " << std::setprecision(1) 
+                      << NUM_PAIRS * ROUNDS * BATCH / ms / 1000.0 << " Mobjects/s, transfer cache hits " 
+                      << centralCache.getTransferHitCount() - hitsBefore << ", span locks " 
+                      << centralCache.getLockAcquireCount() - locksBefore << std::endl;
+        };
+
+        run("Memory Pool", [](size_t size) { return MemoryPool::allocate(size); }, 
+            [](void* ptr, size_t size) { MemoryPool::release(ptr, size); });
+        run("New/Delete ", [](size_t size) { return static_cast<void*>(new char[size]); }, 
+            [](void* ptr, size_t) { delete[] static_cast<char*>(ptr); });
+    }
+    // 23. 线程缓存上限测试：工作集大小不同的线程，统计每个线程的命中率、缓存字节数以及分到的上限
+    static void testThreadCacheBudget() 
+    {
+        constexpr size_t NUM_THREADS = 8;
+        constexpr size_t ROUNDS = 200;
+
+        std::cout << "\nTesting per-class limits and thread cache budget (" << NUM_THREADS << " threads, budget " 
+                  << ThreadCache::DEFAULT_BUDGET / (1024 * 1024) << " MB):" << std::endl;
+
+        struct Result 
+        {
+            size_t workingSet;
+            size_t maxSize;
+            ThreadCache* cache;
+        };
+        std::vector<Result> results(NUM_THREADS);
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t finished = 0;
+        bool exit = false;
+
+        Timer t;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < NUM_THREADS; ++i) 
+        {
+            threads.emplace_back([&, i]() 
+            {
+                // 线程i的工作集为32 << i个对象，奇数线程使用最大256KB的对象，偶数线程只用小对象
+                size_t workingSet = size_t(32) << i;
+                size_t maxSize = (i % 2) ? MAX_BYTES : 512;
+                std::mt19937 gen(i);
+                std::uniform_int_distribution<size_t> dis(8, maxSize);
+                std::vector<std::pair<void*, size_t>> ptrs(workingSet);
+                for (size_t round = 0; round < ROUNDS; ++round) 
+                {
+                    for (auto& [ptr, size] : ptrs) 
+                    {
+                        size = round % 2 ? size : dis(gen);
+                        ptr = MemoryPool::allocate(size);
+                    }
+                    for (const auto& [ptr, size] : ptrs) 
+                    {
+                        MemoryPool::release(ptr, size);
+                    }
+                }
+
+                // 所有线程都完成之后再统计，后完成的线程可能窃取了先完成的线程的上限
+                std::unique_lock<std::mutex> lock(mutex);
+                results[i] = {workingSet, maxSize, ThreadCache::getInstance()};
+                if (++finished == NUM_THREADS) cv.notify_all();
+                cv.wait(lock, [&]() { return exit; });
+            });
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return finished == NUM_THREADS; });
+            double ms = t.elapsed();
+            ThreadCacheStats stats = ThreadCache::getStats();
+
+            std::cout << std::fixed;
+            for (size_t i = 0; i < NUM_THREADS; ++i) 
+            {
+                const Result& r = results[i];
+                size_t allocs = r.cache->allocCount();
+                std::cout << "Thread " << i << " (" << std::setw(4) << r.workingSet << " objects <= " << std::setw(6) 
+                          << r.maxSize << " B): hit rate " << std::setprecision(2) << std::setw(6)
+                          << 100.0 * (allocs - r.cache->missCount()) / allocs << "%, cached " << std::setprecision(1) 
+                          << std::setw(7) << r.cache->cachedBytes() / 1024.0 << " KB, limit " << std::setw(7) 
+                          << r.cache->maxBytes() / 1024.0 << " KB" << std::endl;
+            }
+            std::cout << "Total: " << std::setprecision(3) << ms << " ms, cached " << std::setprecision(1) 
+                      << stats.cachedBytes / 1024.0 << " KB, max per thread " << stats.maxThreadBytes / 1024.0 
+                      << " KB, unclaimed budget " << stats.unclaimedBytes / 1024.0 << " KB" << std::endl;
+            // 空闲的线程同样受预算限制：总缓存不超过预算加上每个线程的最小上限
+            if (stats.cachedBytes > stats.budgetBytes + ThreadCache::MIN_THREAD_BYTES * stats.threadCount) std::abort();
+            exit = true;
+            cv.notify_all();
+        }
+        for (auto& thread : threads) 
+        {
+            thread.join();
+        }
+    }
+    // 24. 生产者/消费者流水线测试：生产者线程申请消息，消费者线程释放，比较远程释放模式开启前后的吞吐量和RSS增长
+    static void testProducerConsumer() 
+    {
+        constexpr size_t NUM_PRODUCERS = 2;
+        constexpr size_t NUM_CONSUMERS = 2;
+        constexpr size_t MESSAGES = 200000; // 每个生产者
+        constexpr size_t BATCH = 64;
+        constexpr size_t MAX_QUEUED = 16; // 队列中最多的批次数，超过时生产者等待
+
+        std::cout << "\nTesting producer/consumer pipeline (" << NUM_PRODUCERS << " producers, " << NUM_CONSUMERS 
+                  << " consumers, " << MESSAGES << " messages of 64-1024 bytes per producer):" << std::endl;
+
+        auto run = [&](const char* name, bool remote) 
+        {
+            MemoryPool::setRemoteFree(remote);
+            MemoryPool::releaseFreeMemory();
+            size_t rssBefore = currentRSS();
+            size_t cachedBefore = ThreadCache::getStats().cachedBytes;
+
+            // 消息按批次通过一个加锁的有界队列交给消费者，nullptr表示生产者结束
+            std::mutex queueMutex;
+            std::condition_variable queueCv;
+            std::vector<std::vector<std::pair<void*, size_t>>*> queue;
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            size_t finished = 0;
+            bool exit = false;
+            auto finish = [&]() 
+            {
+                // 所有线程都完成之后统计RSS和线程缓存，统计完再退出
+                std::unique_lock<std::mutex> lock(mutex);
+                if (++finished == NUM_PRODUCERS + NUM_CONSUMERS) cv.notify_all();
+                cv.wait(lock, [&]() { return exit; });
+            };
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < NUM_PRODUCERS; ++i) 
+            {
+                threads.emplace_back([&, i]() 
+                {
+                    std::mt19937 gen(i);
+                    std::uniform_int_distribution<size_t> dis(64, 1024);
+                    for (size_t sent = 0; sent < MESSAGES; sent += BATCH) 
+                    {
+                        auto* batch = new std::vector<std::pair<void*, size_t>>(BATCH);
+                        for (auto& [ptr, size] : *batch) 
+                        {
+                            size = dis(gen);
+                            ptr = MemoryPool::allocate(size);
+                            static_cast<char*>(ptr)[0] = 1;
+                        }
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        queueCv.wait(lock, [&]() { return queue.size() < MAX_QUEUED; });
+                        queue.push_back(batch);
+                        queueCv.notify_all();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(queueMutex);
+                        queue.push_back(nullptr);
+                        queueCv.notify_all();
+                    }
+                    finish();
+                });
+            }
+            for (size_t i = 0; i < NUM_CONSUMERS; ++i) 
+            {
+                threads.emplace_back([&]() 
+                {
+                    while (true) 
+                    {
+                        std::vector<std::pair<void*, size_t>>* batch = nullptr;
+                        {
+                            std::unique_lock<std::mutex> lock(queueMutex);
+                            queueCv.wait(lock, [&]() { return !queue.empty(); });
+                            batch = queue.back();
+                            queue.pop_back();
+                            queueCv.notify_all();
+                        }
+                        if (!batch) break;
+                        for (const auto& [ptr, size] : *batch) 
+                        {
+                            MemoryPool::release(ptr, size);
+                        }
+                        delete batch;
+                    }
+                    finish();
+                });
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return finished == NUM_PRODUCERS + NUM_CONSUMERS; });
+                double ms = t.elapsed();
+                size_t rssAfter = currentRSS();
+                ThreadCacheStats stats = ThreadCache::getStats();
+                std::cout << name << ": " << std::fixed << std::setprecision(3) << ms << " ms, " 
+                          << std::setprecision(2) << NUM_PRODUCERS * MESSAGES / ms / 1000.0 << " M msgs/s, RSS growth " 
+                          << std::setprecision(1) << (rssAfter > rssBefore ? rssAfter - rssBefore : 0) / 1024.0 
+                          << " KB, pipeline thread caches " << (static_cast<double>(stats.cachedBytes) - cachedBefore) / 1024.0 << " KB" << std::endl;
+                exit = true;
+                cv.notify_all();
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+        };
+
+        run("Local free ", false);
+        run("Remote free", true);
+        MemoryPool::setRemoteFree(false);
+    }
+    // 25. 冷启动稀疏分配测试：新线程在每个size class中只分配一个对象，统计首次分配延迟以及RSS增长
+    // 新Span按需切分，只有真正分配出去的内存块所在的页被写入；预先切分整个Span时所有页都会被写入
+    static void testSparseColdStart() 
+    {
+        std::cout << "\nTesting cold-start sparse allocation (one object per size class, " << FREE_LIST_SIZE 
+                  << " classes):" << std::endl;
+
+        MemoryPool::releaseFreeMemory();
+        size_t rssBefore = currentRSS();
+
+        std::vector<double> latencies;
+        std::vector<void*> ptrs;
+        std::thread([&]() 
+        {
+            for (size_t index = 0; index < FREE_LIST_SIZE; ++index) 
+            {
+                size_t size = SizeClass::classSize(index);
+                auto begin = steady_clock::now();
+                void* ptr = MemoryPool::allocate(size);
+                static_cast<char*>(ptr)[0] = 1;
+                latencies.push_back(duration_cast<nanoseconds>(steady_clock::now() - begin).count() / 1000.0);
+                ptrs.push_back(ptr);
+            }
+            size_t rssAfter = currentRSS();
+
+            // 分配用到的Span的总大小，即预先切分时会写入的字节数
+            std::vector<PageCache::Span*> spans;
+            for (void* ptr : ptrs) 
+            {
+                spans.push_back(PageCache::getInstance().getSpan(ptr));
+            }
+            std::sort(spans.begin(), spans.end());
+            spans.erase(std::unique(spans.begin(), spans.end()), spans.end());
+            size_t spanBytes = 0;
+            for (PageCache::Span* span : spans) 
+            {
+                spanBytes += span->numPages * PageCache::PAGE_SIZE;
+            }
+
+            std::vector<double> sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0;
+            for (double l : latencies) total += l;
+            std::cout << std::fixed << std::setprecision(3) << "First allocation per class: avg " 
+                      << total / latencies.size() << " us, p50 " << sorted[sorted.size() / 2] << " us, max " 
+                      << sorted.back() << " us" << std::endl;
+            std::cout << std::setprecision(1) << "RSS growth " << (rssAfter > rssBefore ? rssAfter - rssBefore : 0) / 1024.0 
+                      << " KB, spans used " << spans.size() << " (" << spanBytes / 1024.0 
+                      << " KB would be written by eager carving)" << std::endl;
+
+            for (size_t index = 0; index < FREE_LIST_SIZE; ++index) 
+            {
+                MemoryPool::release(ptrs[index], SizeClass::classSize(index));
+            }
+        }).join();
+    }
+    // 26. L1-cold对象复用测试：释放一批对象后写一遍大缓冲区把cache中的数据挤出，再重新申请/释放这批对象，统计每次操作的耗时
+    // 从链表中弹出内存块需要读内存块本身（cache未命中），从指针数组中弹出只读线程本地的数组
+    static void testColdReuse() 
+    {
+        constexpr size_t N = 32;
+        constexpr size_t ROUNDS = 2000;
+        constexpr size_t EVICT_BYTES = 4 * 1024 * 1024;
+
+        std::cout << "\nTesting L1-cold object reuse (" << N << " objects, cache evicted with " 
+                  << EVICT_BYTES / (1024 * 1024) << " MB writes between phases):" << std::endl;
+
+        std::vector<char> evict(EVICT_BYTES);
+        auto flushCache = [&](size_t round) 
+        {
+            for (size_t i = 0; i < EVICT_BYTES; i += 64) 
+            {
+                evict[i] = static_cast<char>(round);
+            }
+        };
+
+        std::thread([&]() 
+        {
+            for (size_t size : {16, 64, 256, 288, 1024}) 
+            {
+                std::vector<void*> ptrs(N);
+                for (auto& ptr : ptrs) ptr = MemoryPool::allocate(size);
+                for (void* ptr : ptrs) MemoryPool::release(ptr, size);
+
+                double allocNs = 0.0;
+                double freeNs = 0.0;
+                for (size_t round = 0; round < ROUNDS; ++round) 
+                {
+                    flushCache(round);
+                    auto begin = steady_clock::now();
+                    for (auto& ptr : ptrs) ptr = MemoryPool::allocate(size);
+                    allocNs += duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+
+                    flushCache(round);
+                    begin = steady_clock::now();
+                    for (void* ptr : ptrs) MemoryPool::release(ptr, size);
+                    freeNs += duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+                }
+                std::cout << std::setw(4) << size << " bytes: allocate " << std::fixed << std::setprecision(2) 
+                          << allocNs / (ROUNDS * N) << " ns/op, release " << freeNs / (ROUNDS * N) << " ns/op" << std::endl;
+            }
+        }).join();
+    }
+    // 27. 伪共享测试：每个线程一个计数器，计数器由主线程连续分配
+    // 8字节对齐时相邻线程的计数器落在同一条cache line上，64字节对齐时每个计数器独占一条cache line
+    static void testFalseSharing() 
+    {
+        constexpr size_t NUM_THREADS = 4;
+        constexpr size_t INCREMENTS = 20000000;
+
+        std::cout << "\nTesting false sharing of per-thread counters (" << NUM_THREADS << " threads on " 
+                  << std::thread::hardware_concurrency() << " CPUs, " << INCREMENTS << " increments each):" << std::endl;
+
+        auto run = [&](const char* name, auto alloc, auto dealloc) 
+        {
+            std::vector<std::atomic<size_t>*> counters(NUM_THREADS);
+            for (auto& counter : counters) 
+            {
+                counter = new (alloc()) std::atomic<size_t>(0);
+            }
+            size_t lines = 0;
+            for (size_t i = 1; i < NUM_THREADS; ++i) 
+            {
+                lines += reinterpret_cast<uintptr_t>(counters[i]) / 64 != reinterpret_cast<uintptr_t>(counters[i - 1]) / 64;
+            }
+
+            Timer t;
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < NUM_THREADS; ++i) 
+            {
+                threads.emplace_back([&, i]() 
+                {
+                    std::atomic<size_t>& counter = *counters[i];
+                    for (size_t n = 0; n < INCREMENTS; ++n) 
+                    {
+                        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    }
+                });
+            }
+            for (auto& thread : threads) 
+            {
+                thread.join();
+            }
+            double ms = t.elapsed();
+
+            std::cout << name << ": " << std::fixed << std::setprecision(3) << ms << " ms, " << std::setprecision(2) 
+                      << ms * 1e6 / (NUM_THREADS * INCREMENTS) << " ns/increment, " << lines + 1 
+                      << " cache lines for " << NUM_THREADS << " counters" << std::endl;
+            for (auto* counter : counters) 
+            {
+                if (counter->load() != INCREMENTS) std::abort();
+                dealloc(counter);
+            }
+        };
+
+        run("allocate(8)            ", []() { return MemoryPool::allocate(8); }, 
+            [](void* ptr) { MemoryPool::release(ptr, 8); });
+        run("allocateAligned(8, 64) ", []() { return MemoryPool::allocateAligned(8, 64); }, 
+            [](void* ptr) { MemoryPool::releaseAligned(ptr, 8, 64); });
+    }
+
+    // 28. 倍增增长测试：缓冲区像vector一样每次容量翻倍并写入新增的部分，对比realloc和reallocate
+    // 统计地址不变（原地增长）的次数，小对象在同一个size class中、大对象并入相邻空闲页时都不需要复制
+    static void testReallocGrowth() 
+    {
+        constexpr size_t NUM_BUFFERS = 1000;
+        constexpr size_t SMALL_LIMIT = 4096;
+        constexpr size_t LARGE_LIMIT = 64 * 1024 * 1024;
+        constexpr size_t LARGE_ROUNDS = 10;
+
+        std::cout << "\nTesting doubling growth (" << NUM_BUFFERS << " buffers 8B -> " << SMALL_LIMIT 
+                  << "B interleaved, " << LARGE_ROUNDS << " rounds of one buffer 16B -> " 
+                  << LARGE_LIMIT / (1024 * 1024) << "MB):" << std::endl;
+
+        // 写入[from, to)：每页写一个字节，模拟追加数据，同时让复制的代价占主要部分
+        auto touch = [](void* ptr, size_t from, size_t to) 
+        {
+            char* p = static_cast<char*>(ptr);
+            for (size_t i = from; i < to; i += 4096) 
+            {
+                p[i] = static_cast<char>(i);
+            }
+            p[to - 1] = 1;
+        };
+
+        auto run = [&](const char* name, auto grow, auto dealloc) 
+        {
+            size_t moves = 0;
+            size_t steps = 0;
+
+            // 多个小缓冲区交替增长，相邻的内存块被其他缓冲区占用
+            Timer t;
+            std::vector<void*> buffers(NUM_BUFFERS, nullptr);
+            for (size_t size = 8; size <= SMALL_LIMIT; size *= 2) 
+            {
+                for (auto& buffer : buffers) 
+                {
+                    void* ptr = grow(buffer, size / 2, size);
+                    moves += buffer && ptr != buffer;
+                    steps += buffer != nullptr;
+                    touch(ptr, size / 2, size);
+                    buffer = ptr;
+                }
+            }
+            for (auto& buffer : buffers) 
+            {
+                dealloc(buffer, SMALL_LIMIT);
+            }
+            double smallMs = t.elapsed();
+            size_t smallMoves = moves;
+            size_t smallSteps = steps;
+
+            // 单个缓冲区一直增长到很大
+            moves = 0;
+            steps = 0;
+            Timer t2;
+            for (size_t round = 0; round < LARGE_ROUNDS; ++round) 
+            {
+                void* buffer = nullptr;
+                for (size_t size = 16; size <= LARGE_LIMIT; size *= 2) 
+                {
+                    void* ptr = grow(buffer, size / 2, size);
+                    moves += buffer && ptr != buffer;
+                    steps += buffer != nullptr;
+                    touch(ptr, size / 2, size);
+                    buffer = ptr;
+                }
+                dealloc(buffer, LARGE_LIMIT);
+            }
+            double largeMs = t2.elapsed();
+
+            std::cout << name << ": small " << std::fixed << std::setprecision(3) << smallMs << " ms (" 
+                      << smallMoves << "/" << smallSteps << " moved), large " << largeMs << " ms (" 
+                      << moves << "/" << steps << " moved)" << std::endl;
+        };
+
+        run("realloc    ", [](void* ptr, size_t, size_t newSize) { return realloc(ptr, newSize); }, 
+            [](void* ptr, size_t) { free(ptr); });
+        run("reallocate ", [](void* ptr, size_t oldSize, size_t newSize) { return MemoryPool::reallocate(ptr, oldSize, newSize); }, 
+            [](void* ptr, size_t size) { MemoryPool::release(ptr, size); });
+    }
 };
 
 int main() {
@@ -302,5 +1935,29 @@ int main() {
     PerformanceTest::testSmallAllocation();
     PerformanceTest::testMultiThreaded();
     PerformanceTest::testMixedSizes();
+    PerformanceTest::testCentralLockAcquisitions();
+    PerformanceTest::testInternalFragmentation();
+    PerformanceTest::testThreadStartup();
+    PerformanceTest::testUnsizedRelease();
+    PerformanceTest::testSpanLookup();
+    PerformanceTest::testSpanFragmentation();
+    PerformanceTest::testReleaseAfterSpike();
+    PerformanceTest::testPhaseShift();
+    PerformanceTest::testThreadChurn();
+    PerformanceTest::testLargeBufferChurn();
+    PerformanceTest::testHugePageWalk();
+    PerformanceTest::testZeroedAllocation();
+    PerformanceTest::testHeapGrowth();
+    PerformanceTest::testPerCpuMode();
+    PerformanceTest::testCentralContention();
+    PerformanceTest::testLockProfile();
+    PerformanceTest::testThreadScaling();
+    PerformanceTest::testCrossThreadFree();
+    PerformanceTest::testThreadCacheBudget();
+    PerformanceTest::testProducerConsumer();
+    PerformanceTest::testSparseColdStart();
+    PerformanceTest::testColdReuse();
+    PerformanceTest::testFalseSharing();
+    PerformanceTest::testReallocGrowth();
     return 0;
 }
\ No newline at end of file
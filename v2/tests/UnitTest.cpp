@@ -1,4 +1,10 @@
 #include "../include/MemoryPool.h"
+#include "../include/PageCache.h"
+#include "../include/CentralCache.h"
+#include "../include/LargeCache.h"
+#include "../include/CpuCache.h"
+#include "../include/AdaptiveLock.h"
+#include "../include/ThreadCache.h"
 #include <iostream>
 #include <vector>
 #include <thread>
@@ -7,9 +13,34 @@
 #include <random>
 #include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <new>
+#include <tuple>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
 
 using namespace myMemoryPool;
 
+// 统计全局operator new的调用次数，用于检查内存池内部是否经过全局堆
+static std::atomic<size_t> globalNewCount{0};
+
+void* operator new(size_t size) {
+    globalNewCount.fetch_add(1, std::memory_order_relaxed);
+    if(void* ptr = malloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
 void testBasicAllocation() {
     std::cout << "Running basic allocation test..." << std::endl;
 
@@ -126,6 +157,1128 @@ void testEdgeCases() {
     std::cout << "Edge cases test passed!" << std::endl;
 }
 
+void testSizeClass() {
+    std::cout << "Running size class test..." << std::endl;
+
+    for(size_t size = 1; size <= MAX_BYTES; size ++) {
+        size_t index = SizeClass::getIndex(size);
+        assert(index < FREE_LIST_SIZE);
+        // size落在[classSize(index - 1), classSize(index)]区间内
+        assert(SizeClass::classSize(index) >= size);
+        assert(index == 0 || SizeClass::classSize(index - 1) < size);
+        assert(SizeClass::roundUp(size) == SizeClass::classSize(index));
+        assert(SizeClass::classSize(index) % ALIGNMENT == 0);
+    }
+    assert(SizeClass::classSize(FREE_LIST_SIZE - 1) == MAX_BYTES);
+
+    std::cout << "Size class test passed!" << std::endl;
+}
+
+void testUnsizedRelease() {
+    std::cout << "Running unsized release test..." << std::endl;
+
+    std::vector<void*> ptrs;
+    for(size_t size : {size_t(1), size_t(8), size_t(100), size_t(4096), size_t(40000), MAX_BYTES, MAX_BYTES + 1}) {
+        for(size_t i = 0; i < 100; i ++) {
+            void* ptr = MemoryPool::allocate(size);
+            assert(ptr != nullptr);
+            memset(ptr, 0xab, size);
+            ptrs.push_back(ptr);
+        }
+    }
+
+    for(void* ptr : ptrs) {
+        MemoryPool::release(ptr);
+    }
+    MemoryPool::release(nullptr);
+
+    // 无size释放的内存块回到了正确的链表，再次分配同样大小的内存可以直接复用
+    void* ptr1 = MemoryPool::allocate(100);
+    MemoryPool::release(ptr1);
+    void* ptr2 = MemoryPool::allocate(100);
+    assert(ptr1 == ptr2);
+    MemoryPool::release(ptr2, 100);
+
+    std::cout << "Unsized release test passed!" << std::endl;
+}
+
+void testSpanCoalescing() {
+    std::cout << "Running span coalescing test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    const size_t NUM_PAGES = 10;
+
+    // 申请一个3 * NUM_PAGES页的Span再拆成三个，保证三个Span一定相邻
+    char* spans[3];
+    spans[0] = static_cast<char*>(pageCache.allocateSpan(3 * NUM_PAGES, 0));
+    assert(spans[0] != nullptr);
+    spans[1] = static_cast<char*>(pageCache.splitSpan(spans[0], NUM_PAGES));
+    assert(spans[1] == spans[0] + NUM_PAGES * PageCache::PAGE_SIZE);
+    spans[2] = static_cast<char*>(pageCache.splitSpan(spans[1], NUM_PAGES));
+    assert(spans[2] == spans[1] + NUM_PAGES * PageCache::PAGE_SIZE);
+    for(char* span : spans) {
+        assert(pageCache.getSpan(span)->pageAddr == span && pageCache.getSpan(span)->numPages == NUM_PAGES);
+    }
+    assert(pageCache.splitSpan(spans[2], NUM_PAGES) == nullptr);
+
+    // 先释放中间的Span，再释放左右两边，左右两边释放时都要和中间的空闲Span合并
+    size_t freeBefore = pageCache.getFreePages();
+    pageCache.releaseSpan(spans[1], NUM_PAGES);
+    pageCache.releaseSpan(spans[0], NUM_PAGES);
+    pageCache.releaseSpan(spans[2], NUM_PAGES);
+    assert(pageCache.getFreePages() == freeBefore + 3 * NUM_PAGES);
+
+    // 右边可能还和更早的空闲Span合并，合并后的Span至少包含这三个Span
+    PageCache::Span* merged = pageCache.getSpan(spans[0]);
+    assert(merged != nullptr && merged->isFree && merged->sizeClass == FREE_SPAN_CLASS);
+    assert(static_cast<char*>(merged->pageAddr) <= spans[0]);
+    assert(static_cast<char*>(merged->pageAddr) + merged->numPages * PageCache::PAGE_SIZE >= spans[2] + NUM_PAGES * PageCache::PAGE_SIZE);
+
+    // 中间的页只能查到合并后的Span或者查不到，不能查到已经回收的Span；空闲的页也不属于任何已分配的内存
+    for(size_t i = 0; i < 3 * NUM_PAGES; i ++) {
+        char* page = spans[0] + i * PageCache::PAGE_SIZE;
+        PageCache::Span* span = pageCache.getSpan(page);
+        assert(span == nullptr || span == merged);
+        assert(MemoryPool::usableSize(page) == 0);
+    }
+
+    std::cout << "Span coalescing test passed!" << std::endl;
+}
+
+void testReleaseFreeMemory() {
+    std::cout << "Running release free memory test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    const size_t NUM_PAGES = 16;
+    const size_t bytes = NUM_PAGES * PageCache::PAGE_SIZE;
+
+    char* span = static_cast<char*>(pageCache.allocateSpan(NUM_PAGES, 0));
+    assert(span != nullptr);
+    memset(span, 0xab, bytes);
+    pageCache.releaseSpan(span, NUM_PAGES);
+
+    MemoryPool::releaseFreeMemory();
+    assert(pageCache.getReleasedPages() == pageCache.getFreePages());
+
+    // 已归还的页重新分配后可以直接使用
+    span = static_cast<char*>(pageCache.allocateSpan(NUM_PAGES, 0));
+    assert(span != nullptr);
+    assert(pageCache.getReleasedPages() <= pageCache.getFreePages());
+    memset(span, 0xcd, bytes);
+    assert(span[0] == static_cast<char>(0xcd) && span[bytes - 1] == static_cast<char>(0xcd));
+    pageCache.releaseSpan(span, NUM_PAGES);
+
+    std::cout << "Release free memory test passed!" << std::endl;
+}
+
+void testMetadataAllocation() {
+    std::cout << "Running metadata allocation test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    void* spans[64];
+    size_t newCount = globalNewCount.load();
+
+    // Span的切分、合并以及新申请系统内存都不经过全局堆
+    for(size_t i = 0; i < 64; i ++) {
+        spans[i] = pageCache.allocateSpan(i % 7 + 1, 0);
+        assert(spans[i] != nullptr);
+    }
+    for(size_t i = 0; i < 64; i += 2) {
+        pageCache.releaseSpan(spans[i], i % 7 + 1);
+    }
+    for(size_t i = 1; i < 64; i += 2) {
+        pageCache.releaseSpan(spans[i], i % 7 + 1);
+    }
+    void* large = pageCache.allocateSpan(4 * PageCache::MAX_PAGES, 0);
+    assert(large != nullptr);
+    pageCache.releaseSpan(large, 4 * PageCache::MAX_PAGES);
+
+    assert(globalNewCount.load() == newCount);
+
+    std::cout << "Metadata allocation test passed!" << std::endl;
+}
+
+void testSpanReturn() {
+    std::cout << "Running span return test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    CentralCache& centralCache = CentralCache::getInstance();
+
+    // 这个size class的Span只能切分出一个内存块，取出之后Span就全部在使用中
+    size_t index = SizeClass::getIndex(100000);
+    void* start = nullptr;
+    assert(centralCache.fetchRange(&start, 1, index) == 1);
+
+    PageCache::Span* span = pageCache.getSpan(start);
+    assert(span != nullptr && span->sizeClass == index && span->useCount == 1);
+    size_t numPages = span->numPages;
+
+    // 内存块归还之后，整个Span回到PageCache
+    size_t freeBefore = pageCache.getFreePages();
+    centralCache.returnMemory(&start, 1, index);
+    assert(pageCache.getFreePages() == freeBefore + numPages);
+
+    std::cout << "Span return test passed!" << std::endl;
+}
+
+void testLargeAllocation() {
+    std::cout << "Running large allocation test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    LargeCache& largeCache = LargeCache::getInstance();
+
+    // 大对象由PageCache的Span提供，整个Span只属于这一个大对象
+    const size_t size = 1024 * 1024 + 100;
+    char* ptr = static_cast<char*>(MemoryPool::allocate(size));
+    assert(ptr != nullptr);
+    memset(ptr, 0xab, size);
+
+    PageCache::Span* span = pageCache.getSpan(ptr);
+    assert(span != nullptr && span->pageAddr == ptr && span->sizeClass == LARGE_SIZE_CLASS);
+    assert(span->numPages * PageCache::PAGE_SIZE >= size);
+    assert(pageCache.getSpan(ptr + size - 1) == span);
+
+    // 释放后缓存在LargeCache中，同一档位的申请直接复用
+    size_t hitBefore = largeCache.getHitCount();
+    MemoryPool::release(ptr, size);
+    assert(largeCache.getCachedBytes() >= size);
+    char* ptr2 = static_cast<char*>(MemoryPool::allocate(size + 1000));
+    assert(ptr2 == ptr);
+    assert(largeCache.getHitCount() == hitBefore + 1);
+    MemoryPool::release(ptr2);
+
+    // 超过缓存上限的大对象直接归还给PageCache
+    const size_t hugeSize = 128 * 1024 * 1024;
+    char* huge = static_cast<char*>(MemoryPool::allocate(hugeSize));
+    assert(huge != nullptr);
+    huge[0] = 1;
+    huge[hugeSize - 1] = 1;
+    size_t freeBefore = pageCache.getFreePages();
+    MemoryPool::release(huge, hugeSize);
+    assert(pageCache.getFreePages() == freeBefore + hugeSize / PageCache::PAGE_SIZE);
+
+    // releaseFreeMemory先清空LargeCache
+    MemoryPool::releaseFreeMemory();
+    assert(largeCache.getCachedBytes() == 0);
+    assert(pageCache.getReleasedPages() == pageCache.getFreePages());
+
+    std::cout << "Large allocation test passed!" << std::endl;
+}
+
+void testHugePageMode() {
+    std::cout << "Running huge page mode test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+    pageCache.setHugePageMode(true);
+
+    // 比最大的空闲Span还大的申请一定会向系统申请新的区域，区域的末尾按2MB对齐，剩余的页留在空闲链表中
+    size_t numPages = std::max<size_t>(pageCache.getLargestFreeSpan() + 1, 10);
+    if(numPages % PageCache::HUGE_PAGE_PAGES == 0) numPages ++;
+    char* span = static_cast<char*>(pageCache.allocateSpan(numPages, 0));
+    assert(span != nullptr);
+    memset(span, 0xab, numPages * PageCache::PAGE_SIZE);
+
+    PageCache::Span* rest = pageCache.getSpan(span + numPages * PageCache::PAGE_SIZE);
+    assert(rest != nullptr && rest->isFree);
+    char* regionEnd = static_cast<char*>(rest->pageAddr) + rest->numPages * PageCache::PAGE_SIZE;
+    assert(reinterpret_cast<uintptr_t>(regionEnd) % PageCache::HUGE_PAGE_SIZE == 0);
+
+    // 释放后和区域剩余的页合并
+    size_t restPages = rest->numPages;
+    size_t freeBefore = pageCache.getFreePages();
+    pageCache.releaseSpan(span, numPages);
+    assert(pageCache.getFreePages() == freeBefore + numPages);
+    assert(pageCache.getLargestFreeSpan() >= numPages + restPages);
+
+    pageCache.setHugePageMode(false);
+
+    std::cout << "Huge page mode test passed!" << std::endl;
+}
+
+void testAllocateZeroed() {
+    std::cout << "Running zeroed allocation test..." << std::endl;
+
+    auto isZero = [](const char* p, size_t size) {
+        for(size_t i = 0; i < size; i ++) {
+            if(p[i] != 0) return false;
+        }
+        return true;
+    };
+
+    // 复用弄脏的内存块之后仍然是全0
+    for(size_t size : {size_t(1), size_t(100), size_t(4096), MAX_BYTES, MAX_BYTES + 1, size_t(3 * 1024 * 1024 + 5)}) {
+        for(int round = 0; round < 2; round ++) {
+            char* ptr = static_cast<char*>(MemoryPool::allocateZeroed(size));
+            assert(ptr != nullptr);
+            assert(isZero(ptr, size));
+            memset(ptr, 0xab, size);
+            MemoryPool::release(ptr, size);
+        }
+    }
+
+    // 归还给操作系统之后重新分配的大对象不需要清零，内容也是0
+    const size_t size = 2 * 1024 * 1024;
+    char* ptr = static_cast<char*>(MemoryPool::allocate(size));
+    memset(ptr, 0xcd, size);
+    MemoryPool::release(ptr, size);
+    MemoryPool::releaseFreeMemory();
+    ptr = static_cast<char*>(MemoryPool::allocateZeroed(size));
+    assert(PageCache::getInstance().getSpan(ptr)->isZeroed);
+    assert(isZero(ptr, size));
+    MemoryPool::release(ptr, size);
+
+    // 小对象从清零的Span中新切分出来时也跳过清零；新线程的本地缓存为空，每次申请都要经过CentralCache
+    MemoryPool::releaseFreeMemory();
+    std::thread([&]() {
+        const size_t SMALL = 100000;
+        ThreadCache* cache = ThreadCache::getInstance();
+        std::vector<char*> ptrs;
+        for(int i = 0; i < 64; i ++) {
+            ptrs.push_back(static_cast<char*>(MemoryPool::allocateZeroed(SMALL)));
+            assert(isZero(ptrs.back(), SMALL));
+        }
+        assert(cache->zeroSkipCount() > 0);
+        for(char* p : ptrs) {
+            memset(p, 0xef, SMALL);
+            MemoryPool::release(p, SMALL);
+        }
+
+        // 弄脏之后复用的内存块不能跳过清零
+        size_t skipped = cache->zeroSkipCount();
+        char* p = static_cast<char*>(MemoryPool::allocateZeroed(SMALL));
+        assert(isZero(p, SMALL) && cache->zeroSkipCount() == skipped);
+        MemoryPool::release(p, SMALL);
+    }).join();
+
+    std::cout << "Zeroed allocation test passed!" << std::endl;
+}
+
+void testAddressReservation() {
+    std::cout << "Running address reservation test..." << std::endl;
+
+    PageCache& pageCache = PageCache::getInstance();
+
+    // 先取走所有空闲页，之后的Span都从预留范围中新切分
+    std::vector<std::pair<void*, size_t>> drained;
+    while(size_t pages = pageCache.getLargestFreeSpan()) {
+        drained.emplace_back(pageCache.allocateSpan(pages, 0), pages);
+    }
+
+    const size_t NUM_SPANS = 64;
+    const size_t NUM_PAGES = 16;
+    size_t allocBefore = pageCache.getSystemAllocCount();
+    char* spans[NUM_SPANS];
+    for(auto& span : spans) {
+        span = static_cast<char*>(pageCache.allocateSpan(NUM_PAGES, 0));
+        assert(span != nullptr && pageCache.owns(span));
+    }
+    // 按顺序切分，相邻的Span地址连续，系统调用最多一次（跨过一个COMMIT_BYTES边界）
+    for(size_t i = 1; i < NUM_SPANS; i ++) {
+        assert(spans[i] == spans[i - 1] + NUM_PAGES * PageCache::PAGE_SIZE);
+    }
+    assert(pageCache.getSystemAllocCount() - allocBefore <= 1);
+
+    // 分别申请的Span释放之后合并成一个
+    for(char* span : spans) {
+        pageCache.releaseSpan(span, NUM_PAGES);
+    }
+    assert(pageCache.getLargestFreeSpan() >= NUM_SPANS * NUM_PAGES);
+
+    for(const auto& [span, pages] : drained) {
+        pageCache.releaseSpan(span, pages);
+    }
+
+    // 不是内存池的地址
+    int local = 0;
+    void* heap = malloc(16);
+    assert(!pageCache.owns(&local));
+    assert(!pageCache.owns(heap));
+    free(heap);
+
+    std::cout << "Address reservation test passed!" << std::endl;
+}
+
+void testPerCpuMode() {
+    std::cout << "Running per-CPU mode test..." << std::endl;
+
+    CpuCache& cpuCache = CpuCache::getInstance();
+    if(!MemoryPool::setPerCpuMode(true)) {
+        std::cout << "Per-CPU mode not supported, skipped" << std::endl;
+        return;
+    }
+    assert(CpuCache::currentCpu() >= 0 && cpuCache.cpuCount() > 0);
+
+    // 小对象由CPU缓存提供，不进入ThreadCache
+    size_t threadBytes = ThreadCache::getInstance()->cachedBytes();
+    void* ptr = MemoryPool::allocate(100);
+    assert(ptr != nullptr);
+    MemoryPool::release(ptr, 100);
+    assert(ThreadCache::getInstance()->cachedBytes() == threadBytes);
+    assert(cpuCache.cachedBytes() > 0);
+
+    // 多线程随机分配/释放，数据不会相互覆盖
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; t ++) {
+        threads.emplace_back([t]() {
+            std::vector<std::pair<unsigned char*, size_t>> ptrs;
+            for(size_t i = 0; i < 2000; i ++) {
+                size_t size = (i * 37 + t) % 2048 + 1;
+                auto* p = static_cast<unsigned char*>(MemoryPool::allocate(size));
+                memset(p, t, size);
+                ptrs.emplace_back(p, size);
+            }
+            for(auto& [p, size] : ptrs) {
+                assert(p[0] == t && p[size - 1] == t);
+                MemoryPool::release(p);
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    // 大的size class按字节数限制：反复释放256KB的内存块，每个CPU缓存的字节数不超过两个批次
+    MemoryPool::setPerCpuMode(false);
+    MemoryPool::setPerCpuMode(true);
+    std::vector<void*> blocks;
+    for(int i = 0; i < 64; i ++) {
+        blocks.push_back(MemoryPool::allocate(MAX_BYTES));
+    }
+    for(void* block : blocks) {
+        MemoryPool::release(block, MAX_BYTES);
+    }
+    assert(cpuCache.cachedBytes() <= 2 * std::max(MAX_BATCH_BYTES, MAX_BYTES) * cpuCache.cpuCount());
+
+    // 关闭时缓存全部归还给CentralCache
+    MemoryPool::setPerCpuMode(false);
+    assert(cpuCache.cachedBytes() == 0);
+
+    std::cout << "Per-CPU mode test passed!" << std::endl;
+}
+
+void testTransferCache() {
+    std::cout << "Running transfer cache test..." << std::endl;
+
+    CentralCache& centralCache = CentralCache::getInstance();
+    size_t index = SizeClass::getIndex(64);
+    size_t batchNum = SizeClass::numMoveSize(SizeClass::classSize(index));
+    centralCache.flush();
+
+    // 归还之后，下一次申请直接从转移缓存中取，顺序不变，不加Span链表的锁
+    std::vector<void*> batch(batchNum);
+    assert(centralCache.fetchRange(batch.data(), batchNum, index) == batchNum);
+    std::vector<void*> first = batch;
+    centralCache.returnMemory(batch.data(), batchNum, index);
+
+    size_t locks = centralCache.getLockAcquireCount();
+    size_t hits = centralCache.getTransferHitCount();
+    assert(centralCache.fetchRange(batch.data(), batchNum, index) == batchNum);
+    assert(batch == first);
+    assert(centralCache.getLockAcquireCount() == locks);
+    assert(centralCache.getTransferHitCount() == hits + 1);
+
+    // 转移缓存只复制指针：放进去的内存块内容保持不变
+    for(void* ptr : batch) {
+        memset(ptr, 0x5a, 64);
+    }
+    centralCache.returnMemory(batch.data(), batchNum, index);
+    assert(centralCache.fetchRange(batch.data(), batchNum, index) == batchNum);
+    for(void* ptr : batch) {
+        assert(static_cast<unsigned char*>(ptr)[0] == 0x5a && static_cast<unsigned char*>(ptr)[63] == 0x5a);
+    }
+
+    // 不足一个批次的部分也放入转移缓存，取的时候不够的部分再从Span中取
+    centralCache.returnMemory(batch.data(), batchNum / 2, index);
+    locks = centralCache.getLockAcquireCount();
+    std::vector<void*> mixed(batchNum);
+    assert(centralCache.fetchRange(mixed.data(), batchNum, index) == batchNum);
+    assert(std::equal(batch.begin(), batch.begin() + batchNum / 2, mixed.begin()));
+    assert(centralCache.getLockAcquireCount() == locks + 1);
+    centralCache.returnMemory(mixed.data(), batchNum, index);
+    centralCache.returnMemory(batch.data() + batchNum / 2, batchNum - batchNum / 2, index);
+
+    // 多线程同时放入/取出，内存块不会重复分配
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; t ++) {
+        threads.emplace_back([&, t]() {
+            std::vector<void*> local(batchNum);
+            for(int i = 0; i < 2000; i ++) {
+                size_t n = centralCache.fetchRange(local.data(), batchNum, index);
+                assert(n == batchNum);
+                for(size_t j = 0; j < n; j ++) {
+                    static_cast<char*>(local[j])[63] = static_cast<char>(t);
+                }
+                for(size_t j = 0; j < n; j ++) {
+                    assert(static_cast<char*>(local[j])[63] == static_cast<char>(t));
+                }
+                centralCache.returnMemory(local.data(), n, index);
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    // 转移缓存是无锁的：先放满MAX_CACHED_BATCHES个批次，之后每个线程同时最多取出一个批次，
+    // 转移缓存不会为空也不会溢出，所有申请/归还都不加Span链表的锁
+    std::vector<std::vector<void*>> held(CentralCache::MAX_CACHED_BATCHES, std::vector<void*>(batchNum));
+    for(auto& batch : held) {
+        assert(centralCache.fetchRange(batch.data(), batchNum, index) == batchNum);
+    }
+    for(auto& batch : held) {
+        centralCache.returnMemory(batch.data(), batchNum, index);
+    }
+    locks = centralCache.getLockAcquireCount();
+    threads.clear();
+    for(size_t t = 0; t < CentralCache::MAX_CACHED_BATCHES; t ++) {
+        threads.emplace_back([&]() {
+            std::vector<void*> local(batchNum);
+            for(int i = 0; i < 2000; i ++) {
+                assert(centralCache.fetchRange(local.data(), batchNum, index) == batchNum);
+                centralCache.returnMemory(local.data(), batchNum, index);
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    assert(centralCache.getLockAcquireCount() == locks);
+
+    // flush之后转移缓存为空，再申请需要加锁
+    assert(centralCache.flush() >= batchNum);
+    locks = centralCache.getLockAcquireCount();
+    assert(centralCache.fetchRange(batch.data(), batchNum, index) == batchNum);
+    assert(centralCache.getLockAcquireCount() == locks + 1);
+    centralCache.returnMemory(batch.data(), batchNum, index);
+
+    // 每次只放入半个批次、或者只取走半个批次时，不满的批次会被补满，转移缓存仍然能装下MAX_CACHED_BATCHES个完整批次
+    centralCache.flush();
+    std::vector<void*> blocks(CentralCache::MAX_CACHED_BATCHES * batchNum);
+    for(size_t i = 0; i < blocks.size(); i += batchNum) {
+        assert(centralCache.fetchRange(blocks.data() + i, batchNum, index) == batchNum);
+    }
+    size_t half = batchNum / 2;
+    for(size_t i = 0; i < blocks.size(); i += half) {
+        centralCache.returnMemory(blocks.data() + i, std::min(half, blocks.size() - i), index);
+    }
+    for(int i = 0; i < 4; i ++) {
+        assert(centralCache.fetchRange(batch.data(), half, index) == half);
+        centralCache.returnMemory(batch.data(), half, index);
+    }
+    assert(centralCache.flush() == blocks.size());
+
+    std::cout << "Transfer cache test passed!" << std::endl;
+}
+
+void testAdaptiveLock() {
+    std::cout << "Running adaptive lock test..." << std::endl;
+
+    AdaptiveLock lock;
+    LockStats stats;
+    lock.setStats(&stats);
+    AdaptiveLock::setProfiling(true);
+
+    // 线程数多于CPU核数，临界区中偶尔让出CPU，制造持有锁的线程被抢占的情况
+    const int NUM_THREADS = 16;
+    const int ITERATIONS = 20000;
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < NUM_THREADS; t ++) {
+        threads.emplace_back([&]() {
+            for(int i = 0; i < ITERATIONS; i ++) {
+                std::lock_guard<AdaptiveLock> guard(lock);
+                counter ++;
+                if(i % 1000 == 0) std::this_thread::yield();
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    AdaptiveLock::setProfiling(false);
+
+    assert(counter == size_t(NUM_THREADS) * ITERATIONS);
+    assert(LockStats::total(stats.waitNs) == counter);
+    assert(LockStats::total(stats.holdNs) == counter);
+    assert(stats.parked.load() <= stats.contended.load());
+    assert(LockStats::percentile(stats.holdNs, 0.5) <= LockStats::percentile(stats.holdNs, 0.99));
+
+    stats.reset();
+    assert(LockStats::total(stats.waitNs) == 0 && stats.contended.load() == 0);
+
+    // LargeCache的锁同样计入自己的统计：一次大对象的申请和释放各加锁一次
+    LockStats& largeStats = LargeCache::getInstance().getLockStats();
+    largeStats.reset();
+    AdaptiveLock::setProfiling(true);
+    void* large = MemoryPool::allocate(MAX_BYTES + 1);
+    MemoryPool::release(large, MAX_BYTES + 1);
+    AdaptiveLock::setProfiling(false);
+    assert(LockStats::total(largeStats.holdNs) == 2);
+
+    std::cout << "Adaptive lock test passed!" << std::endl;
+}
+
+void testCentralShards() {
+    std::cout << "Running central shard test..." << std::endl;
+
+    CentralCache& centralCache = CentralCache::getInstance();
+    PageCache& pageCache = PageCache::getInstance();
+    assert(centralCache.shardCount() >= 1 && centralCache.shardCount() <= CentralCache::MAX_SHARDS);
+
+    // 多个线程（可能运行在不同的CPU上）申请的内存块所在的Span都属于有效的分片，
+    // 交给其他线程释放时归还到Span所在的分片
+    size_t index = SizeClass::getIndex(48);
+    std::vector<void*> blocks[4];
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t ++) {
+        threads.emplace_back([&, t]() {
+            for(int i = 0; i < 100; i ++) {
+                void* batch[7];
+                size_t n = centralCache.fetchRange(batch, 7, index);
+                assert(n == 7);
+                for(void* ptr : batch) {
+                    assert(pageCache.getSpan(ptr)->shard < centralCache.shardCount());
+                    blocks[t].push_back(ptr);
+                }
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    for(int t = 0; t < 4; t ++) {
+        std::vector<void*>& mine = blocks[(t + 1) % 4];
+        centralCache.returnMemory(mine.data(), mine.size(), index);
+    }
+
+    std::cout << "Central shard test passed!" << std::endl;
+}
+
+void testThreadExitFlush() {
+    std::cout << "Running thread exit flush test..." << std::endl;
+
+    size_t threadsBefore = ThreadCache::getStats().threadCount;
+    std::atomic<bool> cached{false};
+    std::atomic<bool> done{false};
+
+    std::thread worker([&]() {
+        std::vector<void*> ptrs;
+        for(size_t i = 0; i < 40; i ++) {
+            ptrs.push_back(MemoryPool::allocate(48));
+        }
+        for(void* ptr : ptrs) {
+            MemoryPool::release(ptr, 48);
+        }
+        assert(ThreadCache::getInstance()->cachedBytes() > 0);
+
+        cached = true;
+        while(!done) {
+            std::this_thread::yield();
+        }
+    });
+
+    while(!cached) {
+        std::this_thread::yield();
+    }
+    ThreadCacheStats stats = ThreadCache::getStats();
+    assert(stats.threadCount == threadsBefore + 1);
+    assert(stats.cachedBytes > 0);
+
+    // 线程退出后从注册表中移除，缓存的内存块归还给CentralCache
+    done = true;
+    worker.join();
+    assert(ThreadCache::getStats().threadCount == threadsBefore);
+
+    std::cout << "Thread exit flush test passed!" << std::endl;
+}
+
+void testThreadCacheLimits() {
+    std::cout << "Running thread cache limit test..." << std::endl;
+
+    // 释放大量256KB附近的内存块，线程缓存的字节数不超过本线程的上限
+    std::thread([]() {
+        ThreadCache* cache = ThreadCache::getInstance();
+        std::vector<void*> ptrs;
+        for(int i = 0; i < 64; i ++) {
+            ptrs.push_back(MemoryPool::allocate(200 * 1024));
+        }
+        for(void* ptr : ptrs) {
+            MemoryPool::release(ptr, 200 * 1024);
+            assert(cache->cachedBytes() <= cache->maxBytes());
+        }
+        assert(cache->maxBytes() >= ThreadCache::MIN_THREAD_BYTES);
+    }).join();
+
+    // 反复分配/释放同一批小对象，链表长度上限增大之后几乎全部命中
+    std::thread([]() {
+        ThreadCache* cache = ThreadCache::getInstance();
+        std::vector<void*> ptrs(100);
+        for(int round = 0; round < 100; round ++) {
+            for(auto& ptr : ptrs) ptr = MemoryPool::allocate(64);
+            for(void* ptr : ptrs) MemoryPool::release(ptr, 64);
+        }
+        assert(cache->allocCount() == 10000);
+        assert(cache->missCount() < 100);
+    }).join();
+
+    // 预算用完之后，新线程只窃取其他线程上限中没有用到的部分
+    auto churn = []() {
+        std::vector<void*> ptrs(256);
+        for(int round = 0; round < 20; round ++) {
+            for(auto& ptr : ptrs) ptr = MemoryPool::allocate(16 * 1024);
+            for(void* ptr : ptrs) MemoryPool::release(ptr, 16 * 1024);
+        }
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    ThreadCache* first = nullptr;
+    bool done = false;
+    std::thread owner([&]() {
+        churn();
+        // 取回缓存的内存块并持有，上限中腾出没有用到的部分
+        std::vector<void*> held(256);
+        for(auto& ptr : held) ptr = MemoryPool::allocate(16 * 1024);
+        std::unique_lock<std::mutex> lock(mutex);
+        first = ThreadCache::getInstance();
+        cv.notify_all();
+        cv.wait(lock, [&]() { return done; });
+        for(void* ptr : held) MemoryPool::release(ptr, 16 * 1024);
+    });
+
+    size_t firstBytes = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return first != nullptr; });
+        firstBytes = first->maxBytes();
+    }
+    assert(firstBytes > ThreadCache::MIN_THREAD_BYTES);
+    assert(first->cachedBytes() + ThreadCache::STEAL_BYTES <= firstBytes);
+
+    // 预算调小之后超支，窃取到的部分用于偿还超支，新线程的上限保持MIN_THREAD_BYTES
+    ThreadCache::setBudget(0);
+    ptrdiff_t unclaimed = ThreadCache::getStats().unclaimedBytes;
+    assert(unclaimed < 0);
+    size_t secondBytes = 0;
+    std::thread([&]() {
+        churn();
+        secondBytes = ThreadCache::getInstance()->maxBytes();
+    }).join();
+    assert(secondBytes == ThreadCache::MIN_THREAD_BYTES);
+    assert(first->maxBytes() < firstBytes);
+    assert(first->cachedBytes() <= first->maxBytes());
+    assert(ThreadCache::getStats().unclaimedBytes > unclaimed);
+
+    ThreadCache::setBudget(ThreadCache::DEFAULT_BUDGET);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+    owner.join();
+
+    // 线程依次缓存大量内存之后保持空闲，后面的线程窃取预算，所有线程缓存的总字节数不超过预算加上每个线程的最小上限
+    const size_t budget = 4 * 1024 * 1024;
+    const int NUM_IDLE = 6;
+    ThreadCache::setBudget(budget);
+    std::vector<std::thread> idlers;
+    int ready = 0;
+    done = false;
+    for(int t = 0; t < NUM_IDLE; t ++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return ready == t; });
+        }
+        idlers.emplace_back([&]() {
+            churn();
+            std::unique_lock<std::mutex> lock(mutex);
+            ready ++;
+            cv.notify_all();
+            cv.wait(lock, [&]() { return done; });
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return ready == NUM_IDLE; });
+        ThreadCacheStats stats = ThreadCache::getStats();
+        assert(stats.cachedBytes <= budget + ThreadCache::MIN_THREAD_BYTES * stats.threadCount);
+        done = true;
+    }
+    cv.notify_all();
+    for(auto& thread : idlers) {
+        thread.join();
+    }
+    ThreadCache::setBudget(ThreadCache::DEFAULT_BUDGET);
+
+    std::cout << "Thread cache limit test passed!" << std::endl;
+}
+
+void testRemoteFree() {
+    std::cout << "Running remote free test..." << std::endl;
+
+    // 生产者线程申请，消费者线程释放：开启远程释放模式后内存块回到生产者，而不是留在消费者的缓存中
+    constexpr size_t SIZE = 5000;
+    constexpr size_t COUNT = 1000;
+    MemoryPool::setRemoteFree(true);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<void*> ptrs;
+    int stage = 0;
+    std::thread producer([&]() {
+        ThreadCache* cache = ThreadCache::getInstance();
+        for(size_t i = 0; i < COUNT; i ++) {
+            void* ptr = MemoryPool::allocate(SIZE);
+            memset(ptr, 0x3c, SIZE);
+            ptrs.push_back(ptr);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        stage = 1;
+        cv.notify_all();
+        cv.wait(lock, [&]() { return stage == 2; });
+
+        // 消费者释放完之后再申请同样数量的内存块，第一次未命中时从远程释放队列中全部取回
+        // 取回的字节数超过本线程的上限，一部分会通过scavenge交给CentralCache，所以仍有少量申请
+        size_t fetched = CentralCache::getInstance().getFetchedBlockCount();
+        size_t drained = cache->remoteDrainCount();
+        std::vector<void*> again;
+        for(size_t i = 0; i < COUNT; i ++) {
+            again.push_back(MemoryPool::allocate(SIZE));
+        }
+        assert(cache->remoteDrainCount() - drained == COUNT);
+        assert(CentralCache::getInstance().getFetchedBlockCount() - fetched < COUNT);
+        std::sort(again.begin(), again.end());
+        assert(std::adjacent_find(again.begin(), again.end()) == again.end());
+        for(void* ptr : again) {
+            MemoryPool::release(ptr, SIZE);
+        }
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return stage == 1; });
+    }
+    std::thread([&]() {
+        ThreadCache* cache = ThreadCache::getInstance();
+        for(void* ptr : ptrs) {
+            assert(static_cast<unsigned char*>(ptr)[SIZE - 1] == 0x3c);
+            MemoryPool::release(ptr, SIZE);
+        }
+        assert(cache->remoteFreeCount() == COUNT);
+        assert(cache->cachedBytes() == 0);
+    }).join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stage = 2;
+    }
+    cv.notify_all();
+    producer.join();
+
+    MemoryPool::setRemoteFree(false);
+    std::cout << "Remote free test passed!" << std::endl;
+}
+
+void testExitedOwnerFree() {
+    std::cout << "Running exited owner free test..." << std::endl;
+
+    // 申请内存块的线程退出之后，其他线程释放的内存块不能困在它留下的远程释放队列中
+    constexpr size_t SIZE = 3000;
+    constexpr size_t COUNT = 16;
+    MemoryPool::setRemoteFree(true);
+
+    std::vector<void*> ptrs;
+    std::thread([&]() {
+        for(size_t i = 0; i < COUNT; i ++) {
+            ptrs.push_back(MemoryPool::allocate(SIZE));
+        }
+    }).join();
+
+    // 所属线程已经退出，释放的内存块直接留在本线程（超过链表上限的部分交给CentralCache），之后的申请可以重新取回
+    ThreadCache* cache = ThreadCache::getInstance();
+    size_t remoteFrees = cache->remoteFreeCount();
+    for(void* ptr : ptrs) {
+        MemoryPool::release(ptr, SIZE);
+    }
+    assert(cache->remoteFreeCount() == remoteFrees);
+
+    // 线程缓存和转移缓存中还有其他同样大小的内存块，多申请几倍之后一定包含全部释放的内存块
+    std::vector<void*> again;
+    for(size_t i = 0; i < 4 * COUNT; i ++) {
+        again.push_back(MemoryPool::allocate(SIZE));
+    }
+    std::sort(again.begin(), again.end());
+    for(void* ptr : ptrs) {
+        assert(std::binary_search(again.begin(), again.end(), ptr));
+    }
+    for(void* ptr : again) {
+        MemoryPool::release(ptr, SIZE);
+    }
+
+    MemoryPool::setRemoteFree(false);
+    std::cout << "Exited owner free test passed!" << std::endl;
+}
+
+void testLazyCarving() {
+    std::cout << "Running lazy carving test..." << std::endl;
+
+    CentralCache& centralCache = CentralCache::getInstance();
+    MemoryPool::releaseFreeMemory();
+
+    // 新Span不预先切分：取出一个内存块只移动切分指针，Span中的页都没有被写入
+    size_t index = SizeClass::getIndex(3500);
+    size_t size = SizeClass::classSize(index);
+    void* block = nullptr;
+    assert(centralCache.fetchRange(&block, 1, index) == 1);
+    PageCache::Span* span = PageCache::getInstance().getSpan(block);
+    assert(block == span->pageAddr && span->freeList == nullptr);
+    assert(span->carvePtr == static_cast<char*>(block) + size);
+
+    size_t numPages = span->numPages;
+    std::vector<unsigned char> resident(numPages);
+    assert(mincore(span->pageAddr, numPages * PageCache::PAGE_SIZE, resident.data()) == 0);
+    assert(std::count_if(resident.begin(), resident.end(), [](unsigned char v) { return v & 1; }) == 0);
+
+    // 取出Span中剩下的所有内存块，地址连续且不重复，最后一个内存块不超过Span的末尾
+    size_t blockNum = numPages * PageCache::PAGE_SIZE / size;
+    std::vector<void*> rest(blockNum - 1);
+    assert(centralCache.fetchRange(rest.data(), rest.size(), index) == rest.size());
+    for(size_t i = 0; i < rest.size(); i ++) {
+        assert(rest[i] == static_cast<char*>(block) + (i + 1) * size);
+    }
+    assert(span->carvePtr == span->carveEnd && span->useCount == blockNum);
+
+    // 全部归还之后Span回到PageCache
+    size_t freeBefore = PageCache::getInstance().getFreePages();
+    centralCache.returnMemory(&block, 1, index);
+    centralCache.returnMemory(rest.data(), rest.size(), index);
+    centralCache.flush();
+    assert(PageCache::getInstance().getFreePages() >= freeBefore + numPages);
+
+    std::cout << "Lazy carving test passed!" << std::endl;
+}
+
+void testMagazine() {
+    std::cout << "Running magazine test..." << std::endl;
+
+    std::thread([]() {
+        ThreadCache* cache = ThreadCache::getInstance();
+        constexpr size_t COUNT = ThreadCache::MAGAZINE_SIZE + 8;
+        std::vector<void*> ptrs(COUNT);
+        for(auto& ptr : ptrs) {
+            ptr = MemoryPool::allocate(64);
+            memset(ptr, 0xa5, 64);
+        }
+
+        // 新线程只用了这一个size class，未命中时批次直接写入弹匣，剩下的内存块都在弹匣中
+        size_t left = cache->cachedBytes() / 64;
+        assert(left < ThreadCache::MAGAZINE_SIZE);
+        size_t n = ThreadCache::MAGAZINE_SIZE - left;
+
+        // 释放到弹匣中的内存块不会被写入
+        for(size_t i = 0; i < n; i ++) {
+            MemoryPool::release(ptrs[i], 64);
+        }
+        assert(cache->cachedBytes() == ThreadCache::MAGAZINE_SIZE * 64);
+        for(size_t i = 0; i < n; i ++) {
+            for(size_t j = 0; j < 64; j ++) {
+                assert(static_cast<unsigned char*>(ptrs[i])[j] == 0xa5);
+            }
+        }
+
+        // 弹匣满了之后挂到链表，内存块的前8个字节写入next指针
+        MemoryPool::release(ptrs[n], 64);
+        assert(memcmp(ptrs[n], ptrs[n - 1], 64) != 0);
+
+        // 按后进先出从弹匣中取
+        for(size_t i = n; i > 0; i --) {
+            void* ptr = MemoryPool::allocate(64);
+            assert(ptr == ptrs[i - 1]);
+        }
+        for(size_t i = 0; i < n; i ++) {
+            MemoryPool::release(ptrs[i], 64);
+        }
+        for(size_t i = n + 1; i < COUNT; i ++) {
+            MemoryPool::release(ptrs[i], 64);
+        }
+
+        // 超过256字节的size class不使用弹匣
+        void* big = MemoryPool::allocate(288);
+        memset(big, 0xa5, 288);
+        MemoryPool::release(big, 288);
+        assert(*static_cast<unsigned char*>(big) != 0xa5 || static_cast<unsigned char*>(big)[1] != 0xa5);
+    }).join();
+
+    std::cout << "Magazine test passed!" << std::endl;
+}
+
+void testAlignedAllocation() {
+    std::cout << "Running aligned allocation test..." << std::endl;
+
+    // 各种大小和对齐的组合：地址按要求对齐，整块内存可写，带size和不带size的释放都可以
+    std::vector<size_t> alignments = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 64 * 1024, 2 * 1024 * 1024};
+    std::vector<size_t> sizes = {0, 1, 24, 64, 100, 1000, 5000, 70000, 300000, 3 * 1024 * 1024};
+    std::vector<std::tuple<void*, size_t, size_t>> ptrs;
+    for(size_t alignment : alignments) {
+        for(size_t size : sizes) {
+            void* ptr = MemoryPool::allocateAligned(size, alignment);
+            assert(ptr != nullptr);
+            assert(reinterpret_cast<uintptr_t>(ptr) % alignment == 0);
+            assert(MemoryPool::owns(ptr));
+            memset(ptr, static_cast<int>(alignment), size);
+            ptrs.emplace_back(ptr, size, alignment);
+        }
+    }
+    for(size_t i = 0; i < ptrs.size(); i ++) {
+        auto [ptr, size, alignment] = ptrs[i];
+        if(size > 0) {
+            assert(static_cast<unsigned char*>(ptr)[size - 1] == static_cast<unsigned char>(alignment));
+        }
+        if(i % 2) {
+            MemoryPool::releaseAligned(ptr, size, alignment);
+        }else {
+            MemoryPool::release(ptr);
+        }
+    }
+
+    // 64字节对齐的小对象来自内存块大小是64整数倍的size class，不会跨cache line
+    void* node = MemoryPool::allocateAligned(24, 64);
+    PageCache::Span* span = PageCache::getInstance().getSpan(node);
+    assert(span->sizeClass < FREE_LIST_SIZE && SizeClass::classSize(span->sizeClass) % 64 == 0);
+    MemoryPool::releaseAligned(node, 24, 64);
+
+    // 按页对齐的对象独占一个对齐的Span，释放之后回到PageCache
+    size_t freeBefore = PageCache::getInstance().getFreePages();
+    void* page = MemoryPool::allocateAligned(3 * PageCache::PAGE_SIZE, 16 * PageCache::PAGE_SIZE);
+    span = PageCache::getInstance().getSpan(page);
+    assert(span->pageAddr == page && span->numPages == 3 && span->sizeClass == LARGE_SIZE_CLASS);
+    MemoryPool::releaseAligned(page, 3 * PageCache::PAGE_SIZE, 16 * PageCache::PAGE_SIZE);
+    assert(PageCache::getInstance().getFreePages() >= freeBefore);
+
+    // 不是2的幂的对齐无效
+    assert(MemoryPool::allocateAligned(64, 48) == nullptr);
+    assert(MemoryPool::allocateAligned(64, 0) == nullptr);
+
+    std::cout << "Aligned allocation test passed!" << std::endl;
+}
+
+// 统计/proc/self/maps的行数，即进程当前的内存映射（VMA）数量
+static size_t mappingCount() {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    size_t count = 0;
+    while(std::getline(maps, line)) count ++;
+    return count;
+}
+
+void testReallocate() {
+    std::cout << "Running reallocate test..." << std::endl;
+
+    // usableSize：小对象为size class的大小，大对象为Span中剩余的页
+    for(size_t size : {1, 8, 24, 100, 1000, 5000, 70000, 300000}) {
+        void* ptr = MemoryPool::allocate(size);
+        assert(MemoryPool::usableSize(ptr) == (size <= MAX_BYTES ? SizeClass::classSize(SizeClass::getIndex(size))
+            : PageCache::getInstance().getSpan(ptr)->numPages * PageCache::PAGE_SIZE));
+        MemoryPool::release(ptr, size);
+    }
+    int local = 0;
+    assert(MemoryPool::usableSize(&local) == 0);
+
+    // nullptr相当于allocate，newSize为0相当于release
+    void* ptr = MemoryPool::reallocate(nullptr, 0, 100);
+    assert(ptr != nullptr && MemoryPool::usableSize(ptr) >= 100);
+    assert(MemoryPool::reallocate(ptr, 100, 0) == nullptr);
+
+    // 仍在同一个size class中时返回原来的指针
+    ptr = MemoryPool::allocate(100);
+    size_t usable = MemoryPool::usableSize(ptr);
+    assert(MemoryPool::reallocate(ptr, 100, usable) == ptr);
+
+    // 从小对象逐步增长到大对象，再缩小回小对象，每一步都保留原来的数据
+    size_t size = 100;
+    memset(ptr, 0x5A, size);
+    for(size_t newSize = 150; newSize <= 8 * 1024 * 1024; newSize = newSize * 3 / 2) {
+        ptr = MemoryPool::reallocate(ptr, size, newSize);
+        assert(ptr != nullptr && MemoryPool::usableSize(ptr) >= newSize);
+        for(size_t i = 0; i < size; i += 97) {
+            assert(static_cast<unsigned char*>(ptr)[i] == 0x5A);
+        }
+        memset(ptr, 0x5A, newSize);
+        size = newSize;
+    }
+    ptr = MemoryPool::reallocate(ptr, size, 64);
+    for(size_t i = 0; i < 64; i ++) {
+        assert(static_cast<unsigned char*>(ptr)[i] == 0x5A);
+    }
+    MemoryPool::release(ptr, 64);
+
+    // 大对象右边相邻的页空闲时原地扩展
+    MemoryPool::releaseFreeMemory();
+    const size_t large = 512 * 1024;
+    char* first = static_cast<char*>(MemoryPool::allocate(large));
+    char* second = static_cast<char*>(MemoryPool::allocate(large));
+    if(second == first + large) {
+        memset(first, 0x33, large);
+        MemoryPool::release(second, large);
+        MemoryPool::releaseFreeMemory();
+        assert(MemoryPool::reallocate(first, large, 2 * large) == first);
+        assert(MemoryPool::usableSize(first) >= 2 * large);
+        assert(first[0] == 0x33 && first[large - 1] == 0x33);
+        memset(first, 0x44, 2 * large);
+        MemoryPool::release(first, 2 * large);
+    }else {
+        MemoryPool::release(first, large);
+        MemoryPool::release(second, large);
+    }
+
+    // 右边的页被占用时，大缓冲区通过mremap移动到新的Span，数据不变，原来的页可以复用
+    const size_t huge = ThreadCache::MREMAP_BYTES;
+    char* buffer = static_cast<char*>(MemoryPool::allocate(huge));
+    void* blocker = MemoryPool::allocate(huge);
+    for(size_t i = 0; i < huge; i += PageCache::PAGE_SIZE) {
+        buffer[i] = static_cast<char>(i / PageCache::PAGE_SIZE);
+    }
+    char* moved = static_cast<char*>(MemoryPool::reallocate(buffer, huge, 3 * huge));
+    assert(moved != nullptr && moved != buffer);
+    for(size_t i = 0; i < huge; i += PageCache::PAGE_SIZE) {
+        assert(moved[i] == static_cast<char>(i / PageCache::PAGE_SIZE));
+    }
+    memset(moved, 0x66, 3 * huge);
+    void* reused = MemoryPool::allocate(huge);
+    memset(reused, 0x77, huge);
+    assert(moved[0] == 0x66 && moved[3 * huge - 1] == 0x66);
+    MemoryPool::release(reused, huge);
+    MemoryPool::release(blocker, huge);
+    MemoryPool::release(moved, 3 * huge);
+
+    // 不到MREMAP_BYTES的缓冲区每次增长都被挡住、只能移动时复制数据，映射数量不随增长次数增加
+    size_t mappings = mappingCount();
+    size_t bufferSize = 1024 * 1024;
+    buffer = static_cast<char*>(MemoryPool::allocate(bufferSize));
+    std::vector<void*> blockers;
+    while(bufferSize + 1024 * 1024 < ThreadCache::MREMAP_BYTES) {
+        blockers.push_back(MemoryPool::allocate(MAX_BYTES + 1));
+        buffer = static_cast<char*>(MemoryPool::reallocate(buffer, bufferSize, bufferSize + 1024 * 1024));
+        assert(buffer != nullptr);
+        bufferSize += 1024 * 1024;
+    }
+    MemoryPool::release(buffer, bufferSize);
+    for(void* blocker : blockers) {
+        MemoryPool::release(blocker, MAX_BYTES + 1);
+    }
+    assert(mappingCount() <= mappings + 8);
+
+    // 丢弃的Span从页表中去掉，之后按不属于内存池的内存处理
+    PageCache& pageCache = PageCache::getInstance();
+    size_t lostPages = pageCache.getLostPages();
+    void* lost = pageCache.allocateSpan(4, LARGE_SIZE_CLASS);
+    pageCache.discardSpan(pageCache.getSpan(lost));
+    assert(pageCache.getSpan(lost) == nullptr && MemoryPool::usableSize(lost) == 0);
+    assert(pageCache.getLostPages() == lostPages + 4);
+
+    std::cout << "Reallocate test passed!" << std::endl;
+}
+
 void testStress() {
     std::cout << "Running stress test..." << std::endl;
 
@@ -162,6 +1315,28 @@ int main()
         testMemoryWriting();
         testMultiThreading();
         testEdgeCases();
+        testSizeClass();
+        testUnsizedRelease();
+        testSpanCoalescing();
+        testReleaseFreeMemory();
+        testMetadataAllocation();
+        testSpanReturn();
+        testLargeAllocation();
+        testHugePageMode();
+        testAllocateZeroed();
+        testAddressReservation();
+        testPerCpuMode();
+        testTransferCache();
+        testAdaptiveLock();
+        testCentralShards();
+        testThreadExitFlush();
+        testThreadCacheLimits();
+        testRemoteFree();
+        testExitedOwnerFree();
+        testLazyCarving();
+        testMagazine();
+        testAlignedAllocation();
+        testReallocate();
         testStress();
 
         std::cout << "All tests passed successfully!" << std::endl;